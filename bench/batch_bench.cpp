@@ -0,0 +1,96 @@
+// Batched against per-command application: the same passive add/cancel/modify
+// command stream through applycommand one call at a time and through
+// applycommands in batches, with a small and a very large resting book.
+#include <benchmark/benchmark.h>
+#include "../ordercommand.h"
+
+namespace {
+
+constexpr size_t streamLength = 1 << 20;
+
+// Resting orders and a command stream that keeps the book at that size: a
+// third each adds, cancels and reprices, all passive so nothing trades and
+// the stream stays valid however it is applied. IDs are scattered like client
+// ClOrdIDs, so index and order lookups miss the cache on a large book.
+struct workload {
+    vector<ordercommand> seed;
+    vector<ordercommand> stream;
+};
+
+Price passiveprice(Side side, mt19937_64& rng) {
+    return Price(side == Side::Buy ? 10499 - (int64_t)(rng() % 400) : 10501 + (int64_t)(rng() % 400));
+}
+
+workload makeworkload(size_t resting) {
+    mt19937_64 rng(1);
+    workload w;
+    vector<pair<OrderId, Side>> live;
+    auto add = [&](vector<ordercommand>& out) {
+        Side side = rng() % 2 ? Side::Buy : Side::Sell;
+        OrderId id(rng());
+        out.push_back(ordercommand{ commandtype::New, ordertype::Limit, side, 0, id, passiveprice(side, rng), Qty(10) });
+        live.emplace_back(id, side);
+    };
+    for (size_t i = 0; i < resting; ++i) add(w.seed);
+    while (w.stream.size() < streamLength) {
+        size_t pick = rng() % live.size();
+        auto [id, side] = live[pick];
+        switch (rng() % 3) {
+        case 0:
+            add(w.stream);
+            break;
+        case 1:
+            w.stream.push_back(ordercommand{ commandtype::Cancel, ordertype::Limit, side, 0, id, Price(0), Qty(0) });
+            live[pick] = live.back();
+            live.pop_back();
+            break;
+        default:
+            w.stream.push_back(ordercommand{ commandtype::Modify, ordertype::Limit, side, 0, id, passiveprice(side, rng), Qty(10) });
+            break;
+        }
+    }
+    return w;
+}
+
+unique_ptr<Orderbook> makebook(const workload& w) {
+    auto ob = make_unique<Orderbook>(ladderconfig{ Price(10000), Price(1), 1000 }, w.seed.size() + streamLength);
+    for (const ordercommand& cmd : w.seed) applycommand(*ob, cmd, [](const execevent&) {});
+    return ob;
+}
+
+// Each iteration applies one batch of commands, collecting the events in one
+// buffer; when the stream is used up the book is rebuilt outside the timed region.
+template <bool Batched>
+void BM_Apply(benchmark::State& state) {
+    size_t batch = state.range(1);
+    workload w = makeworkload(state.range(0));
+    auto ob = makebook(w);
+    vector<execevent> events;
+    events.reserve(batch * 4);
+    size_t next = 0;
+    for (auto _ : state) {
+        if (next + batch > w.stream.size()) {
+            state.PauseTiming();
+            ob = makebook(w);
+            next = 0;
+            state.ResumeTiming();
+        }
+        events.clear();
+        if constexpr (Batched)
+            applycommands(*ob, &w.stream[next], batch, events);
+        else
+            for (size_t i = 0; i < batch; ++i)
+                applycommand(*ob, w.stream[next + i], [&](const execevent& ev) { events.push_back(ev); });
+        benchmark::DoNotOptimize(events.data());
+        next += batch;
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+
+} // namespace
+
+// Args: {resting orders, commands per batch}
+BENCHMARK_TEMPLATE(BM_Apply, false)->Name("BM_PerCall")->ArgNames({ "orders", "batch" })->ArgsProduct({ { 1 << 10, 1 << 20 }, { 16 } });
+BENCHMARK_TEMPLATE(BM_Apply, true)->Name("BM_Batched")->ArgNames({ "orders", "batch" })->ArgsProduct({ { 1 << 10, 1 << 20 }, { 4, 16, 64 } });
+
+BENCHMARK_MAIN();
@@ -0,0 +1,92 @@
+// FIX identifier handling: a session's ClOrdID table against the
+// unordered_map<string, OrderId> it replaced, and engine ID formatting
+// against to_string.
+#include <benchmark/benchmark.h>
+#include "../fixids.h"
+
+namespace {
+
+// Both tables behind the same three calls.
+struct maptable {
+    explicit maptable(size_t expected) { map_.reserve(expected); }
+    const OrderId* find(string_view text) const {
+        auto it = map_.find(string(text));
+        return it == map_.end() ? nullptr : &it->second;
+    }
+    bool insert(string_view text, OrderId id) { return map_.emplace(string(text), id).second; }
+    bool erase(string_view text) { return map_.erase(string(text)) > 0; }
+    unordered_map<string, OrderId> map_;
+};
+
+struct flattable {
+    explicit flattable(size_t expected) : table_(expected) {}
+    const OrderId* find(string_view text) const { return table_.find(text); }
+    bool insert(string_view text, OrderId id) { return table_.insert(text, id); }
+    bool erase(string_view text) { return table_.erase(text); }
+    clordidtable table_;
+};
+
+// Client order IDs: short ones like "ORD1234567", or 36-character UUIDs,
+// which do not fit std::string's inline buffer.
+string makeclordid(bool uuid, mt19937_64& rng) {
+    static const char hex[] = "0123456789abcdef";
+    string text;
+    if (!uuid) return "ORD" + to_string(1000000 + rng() % 9000000);
+    for (int i = 0; i < 36; ++i)
+        text += i == 8 || i == 13 || i == 18 || i == 23 ? '-' : hex[rng() % 16];
+    return text;
+}
+
+// Steady state at n live orders on one session: an execution report looks
+// up one order, then one order is done and a new one arrives.
+template <class Table>
+void BM_ReportDoneNew(benchmark::State& state) {
+    size_t n = state.range(0);
+    bool uuid = state.range(1);
+    mt19937_64 rng(1);
+    vector<string> live(n);
+    Table table(n);
+    uint64_t nextid = 1;
+    for (size_t i = 0; i < n; ++i) {
+        live[i] = makeclordid(uuid, rng);
+        while (!table.insert(live[i], OrderId(nextid))) live[i] = makeclordid(uuid, rng);
+        ++nextid;
+    }
+    vector<string> arrivals(1 << 16);
+    for (string& text : arrivals) text = makeclordid(uuid, rng);
+    size_t next = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.find(live[rng() % n]));
+        size_t slot = rng() % n;
+        table.erase(live[slot]);
+        live[slot] = arrivals[next++ & (arrivals.size() - 1)];
+        benchmark::DoNotOptimize(table.insert(live[slot], OrderId(nextid++)));
+    }
+    state.SetItemsProcessed(state.iterations() * 3);
+}
+
+void BM_FormatId(benchmark::State& state) {
+    uint64_t id = 1;
+    char buf[20];
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(formatid(buf, id++));
+        benchmark::DoNotOptimize(buf);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_ToString(benchmark::State& state) {
+    uint64_t id = 1;
+    for (auto _ : state) benchmark::DoNotOptimize(to_string(id++));
+    state.SetItemsProcessed(state.iterations());
+}
+
+} // namespace
+
+// Args: {live orders, UUID ClOrdIDs}
+BENCHMARK_TEMPLATE(BM_ReportDoneNew, maptable)->ArgNames({ "orders", "uuid" })->ArgsProduct({ { 1 << 10, 1 << 18 }, { 0, 1 } });
+BENCHMARK_TEMPLATE(BM_ReportDoneNew, flattable)->ArgNames({ "orders", "uuid" })->ArgsProduct({ { 1 << 10, 1 << 18 }, { 0, 1 } });
+BENCHMARK(BM_FormatId);
+BENCHMARK(BM_ToString);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,79 @@
+// NewOrderSingle decode throughput: the in-place parser against a
+// straightforward decode that splits the message into string fields first
+// (the shape of work QuickFIX's field objects do).
+#include <benchmark/benchmark.h>
+#include "../fixparser.h"
+
+namespace {
+
+constexpr size_t messageCount = 4096;
+
+string withtrailer(const string& body) {
+    string head = "8=FIX.4.2\x01" "9=" + to_string(body.size()) + "\x01";
+    string msg = head + body;
+    unsigned sum = 0;
+    for (unsigned char c : msg) sum += c;
+    char trailer[8];
+    snprintf(trailer, sizeof(trailer), "10=%03u\x01", sum & 0xff);
+    return msg + trailer;
+}
+
+// Realistic header fields followed by the order, ids and prices varying.
+vector<string> makemessages() {
+    mt19937 rng(7);
+    vector<string> out;
+    out.reserve(messageCount);
+    for (size_t i = 0; i < messageCount; ++i) {
+        string body = "35=D\x01" "49=CLIENT01\x01" "56=ENGINE\x01" "34=" + to_string(i + 1)
+            + "\x01" "52=20260101-09:30:00.123\x01" "11=" + to_string(1000000 + i)
+            + "\x01" "21=1\x01" "55=STOCK\x01" "54=" + (rng() % 2 ? "1" : "2")
+            + "\x01" "60=20260101-09:30:00.123\x01" "38=" + to_string(1 + rng() % 1000)
+            + "\x01" "40=2\x01" "44=" + to_string(99000 + rng() % 2000) + ".00\x01" "59=0\x01";
+        out.push_back(withtrailer(body));
+    }
+    return out;
+}
+
+void BM_ParseNewOrderSingle(benchmark::State& state) {
+    vector<string> messages = makemessages();
+    fixneworder order;
+    size_t next = 0, bytes = 0;
+    for (auto _ : state) {
+        const string& msg = messages[next++ & (messageCount - 1)];
+        fixparsestatus st = parsenewordersingle(msg.data(), msg.size(), order);
+        benchmark::DoNotOptimize(st);
+        benchmark::DoNotOptimize(order);
+        bytes += msg.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_ParseNewOrderSingle);
+
+// Split into tag -> string, then convert with stoull/stod.
+void BM_ParseSplitFields(benchmark::State& state) {
+    vector<string> messages = makemessages();
+    size_t next = 0, bytes = 0;
+    for (auto _ : state) {
+        const string& msg = messages[next++ & (messageCount - 1)];
+        map<int, string> fields;
+        size_t pos = 0;
+        while (pos < msg.size()) {
+            size_t eq = msg.find('=', pos);
+            size_t soh = msg.find('\x01', eq);
+            fields[stoi(msg.substr(pos, eq - pos))] = msg.substr(eq + 1, soh - eq - 1);
+            pos = soh + 1;
+        }
+        ordercommand cmd{ commandtype::New, ordertype::Limit, fields[54] == "1" ? Side::Buy : Side::Sell, 0,
+            OrderId(stoull(fields[11])), Price::fromdouble(stod(fields[44])), Qty(llround(stod(fields[38]))) };
+        benchmark::DoNotOptimize(cmd);
+        bytes += msg.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_ParseSplitFields);
+
+} // namespace
+
+BENCHMARK_MAIN();
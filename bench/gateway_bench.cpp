@@ -0,0 +1,134 @@
+// Round-trip latency and throughput of the shared-memory order-entry gateway,
+// with the engine and the client in separate processes.
+//
+//   gateway_bench [roundtrips] [engine-cpu,gateway-cpu,client-cpu]
+//
+// The process forks: the child runs an OrderbookManager plus shmgateway, the
+// parent attaches as a client. Latency is measured one request in flight at a
+// time (send -> status response), then throughput with the ring kept full.
+// Pin the three busy threads to separate cores for meaningful numbers.
+#include "../shmgateway.h"
+#include "orderflow.h"
+#include <sys/wait.h>
+
+static void pincurrent(int cpu) {
+    if (cpu < 0) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// Child: serve until the parent closes its end of the pipe.
+static int runengine(const string& name, int readfd, int shardcpu, int gatewaycpu) {
+    OrderbookManager books(1, { shardcpu });
+    books.addsymbol("BENCH", ladderconfig{ Price(90000), Price(1), 20000 }, 1 << 20);
+    shmgateway gateway(books);
+    gateway.addclient(name);
+    books.start();
+    gateway.start(gatewaycpu);
+    char c;
+    while (::read(readfd, &c, 1) > 0) {}
+    gateway.stop();
+    books.stop();
+    return 0;
+}
+
+static gwresponse await(gwclient& client, eventtype type) {
+    gwresponse resp;
+    int spins = 0;
+    while (true) {
+        if (client.poll(resp)) {
+            if (resp.type_ == (uint8_t)type) return resp;
+            continue;
+        }
+        if (++spins < 1024) cpurelax();
+        else this_thread::yield();
+    }
+}
+
+static void report(const char* what, latencysamples& samples) {
+    printf("%-8s p50 %7.0f ns  p99 %7.0f ns  p99.9 %7.0f ns  max %9.0f ns\n", what,
+        samples.percentile(0.50), samples.percentile(0.99), samples.percentile(0.999), samples.percentile(1.0));
+}
+
+int main(int argc, char** argv) {
+    size_t roundtrips = argc > 1 ? stoul(argv[1]) : 100000;
+    int cpus[3] = { -1, -1, -1 };
+    if (argc > 2) {
+        stringstream ss(argv[2]);
+        string item;
+        for (int i = 0; i < 3 && getline(ss, item, ','); ++i) cpus[i] = stoi(item);
+    }
+    string name = "/obgw.bench." + to_string(::getpid());
+
+    int pipefd[2];
+    if (::pipe(pipefd) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    pid_t pid = ::fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0) {
+        ::close(pipefd[1]);
+        _exit(runengine(name, pipefd[0], cpus[0], cpus[1]));
+    }
+    ::close(pipefd[0]);
+    pincurrent(cpus[2]);
+
+    {
+        gwclient client(name);
+        latencysamples newlat, cancellat;
+        newlat.reserve(roundtrips);
+        cancellat.reserve(roundtrips);
+
+        // Passive orders on alternating sides that never cross, cancelled straight away.
+        for (size_t i = 0; i < roundtrips; ++i) {
+            uint64_t id = i + 1;
+            Side side = i % 2 ? Side::Sell : Side::Buy;
+            int64_t price = side == Side::Buy ? 99990 : 100010;
+            gwrequest req{ (uint8_t)commandtype::New, (uint8_t)ordertype::Limit, (uint8_t)side, 0, 0, id, price, 100 };
+            uint64_t t0 = nowns();
+            while (!client.send(req)) cpurelax();
+            await(client, eventtype::New);
+            uint64_t t1 = nowns();
+            req.type_ = (uint8_t)commandtype::Cancel;
+            while (!client.send(req)) cpurelax();
+            await(client, eventtype::Cancelled);
+            uint64_t t2 = nowns();
+            newlat.add(t1 - t0);
+            cancellat.add(t2 - t1);
+        }
+        printf("%zu round trips, one in flight\n", roundtrips);
+        report("new", newlat);
+        report("cancel", cancellat);
+
+        // Pipelined: keep sending new/cancel pairs while draining responses.
+        size_t sent = 0, received = 0, total = roundtrips * 2;
+        uint64_t id = roundtrips + 1;
+        gwresponse resp;
+        auto start = chrono::steady_clock::now();
+        while (received < total) {
+            if (sent < total) {
+                gwrequest req{ (uint8_t)(sent % 2 ? commandtype::Cancel : commandtype::New), (uint8_t)ordertype::Limit,
+                    (uint8_t)Side::Buy, 0, 0, id, 99990, 100 };
+                if (client.send(req)) {
+                    if (++sent % 2 == 0) ++id;
+                    continue;
+                }
+            }
+            if (client.poll(resp)) ++received;
+            else cpurelax();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        printf("pipelined %zu requests in %.1f ms: %.2f M req/s\n", total, seconds * 1e3, total / seconds / 1e6);
+    }
+
+    ::close(pipefd[1]);
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
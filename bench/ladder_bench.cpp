@@ -0,0 +1,62 @@
+// Map vs array-ladder backends for add/cancel/match.
+#include <benchmark/benchmark.h>
+#include "../orderbook.h"
+
+namespace {
+
+constexpr int basePrice = 10000;
+constexpr int priceRange = 2000;
+
+Orderbook makeBook(bool dense) {
+    return dense ? Orderbook(ladderconfig{ Price(basePrice), Price(1), priceRange }, 1 << 16) : Orderbook(1 << 16);
+}
+
+Order limit(int id, Side side, int64_t price, int quantity) {
+    return Order(ordertype::Limit, OrderId(id), side, Price(price), Qty(quantity));
+}
+
+// Rest `depth` levels on each side with a spread around the middle of the range.
+void seed(Orderbook& ob, int depth, int& nextid) {
+    int mid = basePrice + priceRange / 2;
+    for (int i = 0; i < depth; ++i) {
+        ob.addorder(limit(nextid++, Side::Buy, mid - 1 - i, 10));
+        ob.addorder(limit(nextid++, Side::Sell, mid + 1 + i, 10));
+    }
+}
+
+void BM_AddCancel(benchmark::State& state) {
+    Orderbook ob = makeBook(state.range(0));
+    int nextid = 1;
+    seed(ob, state.range(1), nextid);
+    int mid = basePrice + priceRange / 2;
+    int i = 0;
+    for (auto _ : state) {
+        int id = nextid++;
+        // Passive bid somewhere behind the touch, so it opens or joins a level.
+        ob.addorder(limit(id, Side::Buy, mid - 1 - (i++ % state.range(1)) - 1, 5));
+        ob.cancelorder(OrderId(id));
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+
+void BM_Match(benchmark::State& state) {
+    Orderbook ob = makeBook(state.range(0));
+    int nextid = 1;
+    seed(ob, state.range(1), nextid);
+    int mid = basePrice + priceRange / 2;
+    for (auto _ : state) {
+        // Replenish the best ask, then take it out with a crossing bid; each round
+        // empties and recreates the best level.
+        ob.addorder(limit(nextid++, Side::Sell, mid, 10));
+        benchmark::DoNotOptimize(ob.addorder(limit(nextid++, Side::Buy, mid, 10)));
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+
+} // namespace
+
+// Args: {dense backend, levels seeded per side}
+BENCHMARK(BM_AddCancel)->ArgNames({ "dense", "depth" })->ArgsProduct({ { 0, 1 }, { 10, 500 } });
+BENCHMARK(BM_Match)->ArgNames({ "dense", "depth" })->ArgsProduct({ { 0, 1 }, { 10, 500 } });
+
+BENCHMARK_MAIN();
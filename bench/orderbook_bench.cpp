@@ -0,0 +1,221 @@
+// Order book operations under synthetic flow, with per-operation latency
+// percentiles reported as counters (add_p50_ns, cancel_p99_ns, ...).
+#include <benchmark/benchmark.h>
+#include "orderflow.h"
+#include "perfcounters.h"
+
+namespace {
+
+using clk = chrono::steady_clock;
+
+constexpr size_t flowLength = 1 << 20;
+
+flowconfig configfrom(const benchmark::State& state) {
+    flowconfig config;
+    config.depth = state.range(0);
+    config.cancelpct = state.range(1);
+    config.aggressivepct = state.range(2);
+    config.normalprices = state.range(3) != 0;
+    config.owners = state.range(4);
+    config.stops = state.range(5);
+    return config;
+}
+
+void report(benchmark::State& state, const char* name, latencysamples& samples) {
+    string prefix(name);
+    state.counters[prefix + "_p50_ns"] = samples.percentile(0.50);
+    state.counters[prefix + "_p99_ns"] = samples.percentile(0.99);
+    state.counters[prefix + "_p999_ns"] = samples.percentile(0.999);
+}
+
+// Mixed add/cancel/modify flow through addorder, cancelorder and Matchorder.
+// Each iteration applies one step; when the flow is used up the book is
+// rebuilt outside the timed region. With owners, adds belong to random owners
+// and the book cancels the resting side of any self-trade. With stops, that
+// many dormant stop orders sit in the book without ever triggering.
+void BM_Flow(benchmark::State& state) {
+    flowconfig config = configfrom(state);
+    vector<flowstep> flow = makeflow(config, flowLength);
+    auto newbook = [&] {
+        auto ob = make_unique<Orderbook>(flowLength + config.stops);
+        if (config.owners > 0) ob->setstpmode(stpmode::CancelOldest);
+        seedstops(*ob, config, seedbook(*ob, config));
+        return ob;
+    };
+    auto ob = newbook();
+
+    latencysamples adds, cancels, modifies;
+    adds.reserve(flowLength);
+    cancels.reserve(flowLength);
+    modifies.reserve(flowLength);
+    size_t tradecount = 0;
+    auto sink = [&](const trade&) { ++tradecount; };
+
+    size_t next = 0;
+    for (auto _ : state) {
+        if (next == flow.size()) {
+            state.PauseTiming();
+            ob = newbook();
+            next = 0;
+            state.ResumeTiming();
+        }
+        const flowstep& step = flow[next++];
+        auto start = clk::now();
+        switch (step.op_) {
+        case flowop::Add:
+            ob->addorder(Order(ordertype::Limit, step.id_, step.side_, step.price_, step.quantity_, step.owner_), sink);
+            adds.add((clk::now() - start).count());
+            break;
+        case flowop::Cancel:
+            ob->cancelorder(step.id_);
+            cancels.add((clk::now() - start).count());
+            break;
+        case flowop::Modify:
+            ob->Matchorder(ordermodify(step.id_, step.side_, step.price_, step.quantity_), sink);
+            modifies.add((clk::now() - start).count());
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["trades"] = (double)tradecount;
+    report(state, "add", adds);
+    report(state, "cancel", cancels);
+    report(state, "modify", modifies);
+}
+
+// Full-book snapshot at a given depth.
+void BM_GetOrderInfo(benchmark::State& state) {
+    flowconfig config;
+    config.depth = state.range(0);
+    Orderbook ob;
+    seedbook(ob, config);
+    latencysamples snapshots;
+    for (auto _ : state) {
+        auto start = clk::now();
+        benchmark::DoNotOptimize(ob.getorderinfo());
+        snapshots.add((clk::now() - start).count());
+    }
+    state.SetItemsProcessed(state.iterations());
+    report(state, "snapshot", snapshots);
+}
+
+// Top-N depth copy into a caller buffer.
+void BM_GetDepth(benchmark::State& state) {
+    flowconfig config;
+    config.depth = state.range(0);
+    Orderbook ob;
+    seedbook(ob, config);
+    vector<Levelinfo> buffer(state.range(1));
+    latencysamples snapshots;
+    for (auto _ : state) {
+        auto start = clk::now();
+        benchmark::DoNotOptimize(ob.getdepth(Side::Buy, buffer.data(), buffer.size()));
+        benchmark::DoNotOptimize(ob.getdepth(Side::Sell, buffer.data(), buffer.size()));
+        snapshots.add((clk::now() - start).count());
+    }
+    state.SetItemsProcessed(state.iterations());
+    report(state, "depth", snapshots);
+}
+
+// Stop cascade: a one-lot market buy lifts the first of `levels` ask levels,
+// each holding `perlevel` lots with `perlevel` one-lot buy stops parked at its
+// price. Every level's last stop trades into the next level and fires the
+// stops there, so the whole ladder is swept by triggered stops. Items are
+// stops fired; `dormant` stops parked beyond the ladder never fire.
+void BM_StopCascade(benchmark::State& state) {
+    int levels = state.range(0);
+    int perlevel = state.range(1);
+    flowconfig config;
+    config.depth = levels;
+    config.stops = state.range(2);
+    size_t fired = 0;
+    auto sink = [&](const auto& e) {
+        if constexpr (is_same_v<decay_t<decltype(e)>, stoptrigger>) ++fired;
+    };
+    unique_ptr<Orderbook> ob;
+    int id = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        ob = make_unique<Orderbook>(levels * (perlevel + 1) + config.stops + 1);
+        // Dormant stops first, so the cascade's own orders are the most recently touched.
+        id = seedstops(*ob, config, 1);
+        for (int level = 1; level <= levels; ++level) {
+            ob->addorder(Order(ordertype::Limit, OrderId(id++), Side::Sell, Price(config.mid + level), Qty(perlevel)));
+            for (int k = 0; k < perlevel; ++k) {
+                Order stop(ordertype::Stop, OrderId(id++), Side::Buy, Price::none(), Qty(1));
+                stop.setstopprice(Price(config.mid + level));
+                ob->addorder(stop);
+            }
+        }
+        state.ResumeTiming();
+        ob->addorder(Order(OrderId(id), Side::Buy, Qty(1)), sink);
+    }
+    state.SetItemsProcessed(fired);
+}
+
+// Deep sweep: one market buy takes out `levels` ask levels of `perlevel`
+// one-lot orders each. The orders arrive in shuffled level order, so queue
+// neighbours are scattered over the pool as they are after a day of churn and
+// every order the sweep passes is a cache miss. Items are resting orders
+// matched; with hardware counters available, misses per order are reported.
+void BM_Sweep(benchmark::State& state) {
+    int levels = state.range(0);
+    int perlevel = state.range(1);
+    int mid = 100000;
+    vector<int> arrivals;
+    for (int level = 1; level <= levels; ++level) arrivals.insert(arrivals.end(), perlevel, level);
+    shuffle(arrivals.begin(), arrivals.end(), mt19937(42));
+    perfcounters counters;
+    unique_ptr<Orderbook> ob;
+    size_t matched = 0;
+    auto sink = [&](const trade&) { ++matched; };
+    for (auto _ : state) {
+        state.PauseTiming();
+        ob.reset();
+        ob = make_unique<Orderbook>(arrivals.size());
+        int id = 1;
+        for (int level : arrivals)
+            ob->addorder(Order(ordertype::Limit, OrderId(id++), Side::Sell, Price(mid + level), Qty(1)));
+        state.ResumeTiming();
+        counters.start();
+        ob->addorder(Order(OrderId(id), Side::Buy, Qty(levels * perlevel)), sink);
+        counters.stop();
+    }
+    state.SetItemsProcessed(matched);
+    if (!counters.available()) state.SetLabel("no perf counters");
+    counters.report((double)matched, [&](const string& name, double value) {
+        state.counters[name + "_per_order"] = value;
+        });
+}
+
+} // namespace
+
+// Args: {depth, cancel %, aggressive %, normal price distribution, owners, dormant stops}
+BENCHMARK(BM_Flow)
+    ->ArgNames({ "depth", "cancel", "aggr", "normal", "owners", "stops" })
+    ->Args({ 20, 30, 10, 1, 0, 0 })
+    ->Args({ 200, 30, 10, 1, 0, 0 })
+    ->Args({ 200, 60, 5, 1, 0, 0 })
+    ->Args({ 200, 30, 30, 1, 0, 0 })
+    ->Args({ 200, 30, 10, 0, 0, 0 })
+    ->Args({ 2000, 30, 10, 0, 0, 0 })
+    ->Args({ 200, 30, 10, 1, 16, 0 })
+    ->Args({ 200, 30, 30, 1, 16, 0 })
+    ->Args({ 200, 30, 10, 1, 0, 100000 })
+    ->Args({ 200, 30, 10, 1, 0, 1000000 });
+// Args: {ask levels, lots and stops per level, dormant stops}
+BENCHMARK(BM_StopCascade)
+    ->ArgNames({ "levels", "perlevel", "dormant" })
+    ->Args({ 100, 10, 0 })
+    ->Args({ 100, 10, 100000 })
+    ->Args({ 1000, 4, 0 });
+// Args: {ask levels, orders per level}
+BENCHMARK(BM_Sweep)
+    ->ArgNames({ "levels", "perlevel" })
+    ->Args({ 100, 100 })
+    ->Args({ 1000, 100 })
+    ->Args({ 100, 10000 });
+BENCHMARK(BM_GetOrderInfo)->ArgNames({ "depth" })->Arg(20)->Arg(200)->Arg(2000);
+BENCHMARK(BM_GetDepth)->ArgNames({ "depth", "top" })->Args({ 2000, 5 })->Args({ 2000, 20 });
+
+BENCHMARK_MAIN();
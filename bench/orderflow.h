@@ -0,0 +1,120 @@
+#ifndef ORDERFLOW_H
+#define ORDERFLOW_H
+
+#include "../orderbook.h"
+
+// Synthetic order flow for benchmarks: a stream of adds, cancels and modifies
+// around a fixed mid price.
+struct flowconfig {
+    int depth = 100;           // Passive prices span this many ticks each side of mid.
+    int cancelpct = 30;        // Share of steps that cancel a previously added order.
+    int modifypct = 10;        // Share of steps that modify a previously added order.
+    int aggressivepct = 10;    // Share of adds priced through the opposite side.
+    bool normalprices = true;  // Passive prices ~ half-normal from the touch, else uniform.
+    int maxquantity = 100;
+    int owners = 0;            // Adds get a random owner 1..owners; 0 leaves them unowned.
+    int stops = 0;             // Dormant stop orders parked outside the traded range.
+    int mid = 100000;
+    uint32_t seed = 42;
+};
+
+enum class flowop : uint8_t { Add, Cancel, Modify };
+
+struct flowstep {
+    flowop op_;
+    Side side_;
+    OrderId id_;
+    Price price_;
+    Qty quantity_;
+    uint32_t owner_ = 0;
+};
+
+// Cancels and modifies pick a random earlier order; some of those will have
+// filled already, which is realistic and exercises the miss path.
+inline vector<flowstep> makeflow(const flowconfig& config, size_t steps, int firstid = 1) {
+    mt19937 rng(config.seed);
+    uniform_int_distribution<int> pct(0, 99);
+    uniform_int_distribution<int> qty(1, config.maxquantity);
+    uniform_int_distribution<int> uniform(1, config.depth);
+    normal_distribution<double> normal(0.0, config.depth / 3.0);
+    auto passiveoffset = [&] {
+        if (!config.normalprices) return uniform(rng);
+        return 1 + min(config.depth - 1, (int)abs(normal(rng)));
+    };
+
+    vector<flowstep> flow;
+    flow.reserve(steps);
+    vector<pair<int, Side>> added;
+    int nextid = firstid;
+    for (size_t i = 0; i < steps; ++i) {
+        int roll = pct(rng);
+        if (!added.empty() && roll < config.cancelpct) {
+            auto [id, side] = added[rng() % added.size()];
+            flow.push_back({ flowop::Cancel, side, OrderId(id), Price(0), Qty(0) });
+            continue;
+        }
+        if (!added.empty() && roll < config.cancelpct + config.modifypct) {
+            auto [id, side] = added[rng() % added.size()];
+            int offset = passiveoffset();
+            int price = side == Side::Buy ? config.mid - offset : config.mid + offset;
+            flow.push_back({ flowop::Modify, side, OrderId(id), Price(price), Qty(qty(rng)) });
+            continue;
+        }
+        Side side = rng() & 1 ? Side::Buy : Side::Sell;
+        int offset = pct(rng) < config.aggressivepct ? -passiveoffset() : passiveoffset();
+        int price = side == Side::Buy ? config.mid - offset : config.mid + offset;
+        uint32_t owner = config.owners > 0 ? 1 + rng() % config.owners : 0;
+        flow.push_back({ flowop::Add, side, OrderId(nextid), Price(price), Qty(qty(rng)), owner });
+        added.push_back({ nextid++, side });
+    }
+    return flow;
+}
+
+// Rest `depth` passive levels per side so the book starts populated.
+inline int seedbook(Orderbook& ob, const flowconfig& config, int ordersperlevel = 4, int firstid = 1 << 30) {
+    int id = firstid;
+    for (int level = 1; level <= config.depth; ++level)
+        for (int k = 0; k < ordersperlevel; ++k) {
+            ob.addorder(Order(ordertype::Limit, OrderId(id++), Side::Buy, Price(config.mid - level), Qty(config.maxquantity)));
+            ob.addorder(Order(ordertype::Limit, OrderId(id++), Side::Sell, Price(config.mid + level), Qty(config.maxquantity)));
+        }
+    return id;
+}
+
+// Park config.stops stop orders, alternately buy and sell, at stop prices
+// beyond the passive depth. The flow only ever trades within it, so they all
+// stay dormant.
+inline int seedstops(Orderbook& ob, const flowconfig& config, int firstid) {
+    int id = firstid;
+    for (int i = 0; i < config.stops; ++i) {
+        Side side = i % 2 ? Side::Sell : Side::Buy;
+        int offset = config.depth + 1 + i % 1000;
+        Order stop(ordertype::Stop, OrderId(id++), side, Price::none(), Qty(config.maxquantity));
+        stop.setstopprice(Price(side == Side::Buy ? config.mid + offset : config.mid - offset));
+        ob.addorder(stop);
+    }
+    return id;
+}
+
+// Latency samples for one operation type, summarized into percentiles.
+class latencysamples {
+public:
+    void reserve(size_t n) { samples_.reserve(n); }
+    void add(uint64_t ns) { samples_.push_back(ns); }
+    size_t size() const { return samples_.size(); }
+    // p in [0, 1]; sorts lazily.
+    double percentile(double p) {
+        if (samples_.empty()) return 0;
+        if (!sorted_) {
+            sort(samples_.begin(), samples_.end());
+            sorted_ = true;
+        }
+        size_t idx = min(samples_.size() - 1, (size_t)(p * samples_.size()));
+        return (double)samples_[idx];
+    }
+private:
+    vector<uint64_t> samples_;
+    bool sorted_ = false;
+};
+
+#endif // ORDERFLOW_H
@@ -0,0 +1,117 @@
+// Order-ID index: the flat open-addressing table against the node-based
+// unordered_map it replaced, with 1M+ resting orders.
+#include <benchmark/benchmark.h>
+#include "../orderbook.h"
+
+namespace {
+
+struct node {
+    uint64_t payload_;
+};
+
+// Both indexes behind the same three calls.
+struct mapindex {
+    explicit mapindex(size_t expected) { map_.reserve(expected); }
+    node* find(OrderId id) const {
+        auto it = map_.find(id);
+        return it == map_.end() ? nullptr : it->second;
+    }
+    bool insert(OrderId id, node* n) { return map_.emplace(id, n).second; }
+    node* erase(OrderId id) {
+        auto it = map_.find(id);
+        if (it == map_.end()) return nullptr;
+        node* n = it->second;
+        map_.erase(it);
+        return n;
+    }
+    unordered_map<OrderId, node*> map_;
+};
+
+struct flatindex {
+    explicit flatindex(size_t expected) : index_(expected) {}
+    node* find(OrderId id) const { return index_.find(id); }
+    bool insert(OrderId id, node* n) { return index_.insert(id, n); }
+    node* erase(OrderId id) { return index_.erase(id); }
+    orderindex<node> index_;
+};
+
+// Resting order IDs: sequential like engine-assigned IDs, or scattered like
+// client ClOrdIDs.
+vector<uint64_t> makeids(size_t n, bool sequential, mt19937_64& rng) {
+    vector<uint64_t> ids(n);
+    for (size_t i = 0; i < n; ++i) ids[i] = sequential ? (1ull << 48) + i : rng();
+    return ids;
+}
+
+template <class Index>
+void BM_Find(benchmark::State& state) {
+    size_t n = state.range(0);
+    mt19937_64 rng(1);
+    vector<uint64_t> ids = makeids(n, state.range(1), rng);
+    vector<node> nodes(n);
+    Index index(n);
+    for (size_t i = 0; i < n; ++i) index.insert(OrderId(ids[i]), &nodes[i]);
+    shuffle(ids.begin(), ids.end(), rng);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(index.find(OrderId(ids[i])));
+        if (++i == n) i = 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Steady state at n resting orders: cancel a random one, add a new one.
+template <class Index>
+void BM_CancelAdd(benchmark::State& state) {
+    size_t n = state.range(0);
+    bool sequential = state.range(1);
+    mt19937_64 rng(1);
+    vector<uint64_t> ids = makeids(n, sequential, rng);
+    vector<node> nodes(n);
+    Index index(n);
+    for (size_t i = 0; i < n; ++i) index.insert(OrderId(ids[i]), &nodes[i]);
+    uint64_t nextid = (1ull << 48) + n;
+    for (auto _ : state) {
+        size_t slot = rng() % n;
+        node* freed = index.erase(OrderId(ids[slot]));
+        ids[slot] = sequential ? nextid++ : rng();
+        benchmark::DoNotOptimize(index.insert(OrderId(ids[slot]), freed));
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+
+// Through the book: add and cancel passive orders with n already resting.
+void BM_BookCancelAdd(benchmark::State& state) {
+    size_t n = state.range(0);
+    Orderbook ob(ladderconfig{ Price(10000), Price(1), 1000 }, n);
+    mt19937_64 rng(1);
+    vector<uint64_t> ids(n);
+    for (size_t i = 0; i < n; ++i) {
+        ids[i] = (1ull << 48) + i;
+        Side side = i % 2 ? Side::Buy : Side::Sell;
+        int64_t price = side == Side::Buy ? 10499 - (int64_t)(rng() % 400) : 10501 + (int64_t)(rng() % 400);
+        ob.addorder(Order(ordertype::Limit, OrderId(ids[i]), side, Price(price), Qty(10)), [](const trade&) {});
+    }
+    uint64_t nextid = (1ull << 48) + n;
+    for (auto _ : state) {
+        size_t slot = rng() % n;
+        optional<Order> order = ob.findorder(OrderId(ids[slot]));
+        Side side = order->getside();
+        Price price = order->getprice();
+        ob.cancelorder(OrderId(ids[slot]));
+        ids[slot] = nextid++;
+        ob.addorder(Order(ordertype::Limit, OrderId(ids[slot]), side, price, Qty(10)), [](const trade&) {});
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+
+} // namespace
+
+// Args: {resting orders, sequential IDs}
+BENCHMARK_TEMPLATE(BM_Find, mapindex)->ArgNames({ "orders", "seq" })->ArgsProduct({ { 1 << 20, 1 << 22 }, { 0, 1 } });
+BENCHMARK_TEMPLATE(BM_Find, flatindex)->ArgNames({ "orders", "seq" })->ArgsProduct({ { 1 << 20, 1 << 22 }, { 0, 1 } });
+BENCHMARK_TEMPLATE(BM_CancelAdd, mapindex)->ArgNames({ "orders", "seq" })->ArgsProduct({ { 1 << 20, 1 << 22 }, { 0, 1 } });
+BENCHMARK_TEMPLATE(BM_CancelAdd, flatindex)->ArgNames({ "orders", "seq" })->ArgsProduct({ { 1 << 20, 1 << 22 }, { 0, 1 } });
+BENCHMARK(BM_BookCancelAdd)->ArgName("orders")->Arg(1 << 20);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,73 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <bits/stdc++.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+using namespace std;
+
+// Hardware cache-miss counters for this thread, read through perf_event_open
+// (Google Benchmark's own --benchmark_perf_counters needs it built with
+// libpfm). Counting needs a PMU the kernel exposes to the process, so bare
+// metal or a VM with a virtual PMU, and perf_event_paranoid <= 2. Counters the
+// machine cannot provide are left out of the report rather than shown as 0.
+class perfcounters {
+public:
+    perfcounters() {
+        open("l1d_miss", PERF_TYPE_HW_CACHE, cacheevent(PERF_COUNT_HW_CACHE_L1D));
+        open("llc_miss", PERF_TYPE_HW_CACHE, cacheevent(PERF_COUNT_HW_CACHE_LL));
+        open("dtlb_miss", PERF_TYPE_HW_CACHE, cacheevent(PERF_COUNT_HW_CACHE_DTLB));
+    }
+    perfcounters(const perfcounters&) = delete;
+    perfcounters& operator=(const perfcounters&) = delete;
+    ~perfcounters() {
+        for (counter& c : counters_) close(c.fd_);
+    }
+
+    bool available() const { return !counters_.empty(); }
+
+    // Count between start() and stop(); totals accumulate across pairs.
+    void start() {
+        for (counter& c : counters_) ioctl(c.fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    void stop() {
+        for (counter& c : counters_) ioctl(c.fd_, PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    // Hand each counter's total divided by per to f(name, value).
+    template <class F>
+    void report(double per, F f) const {
+        for (const counter& c : counters_) {
+            uint64_t value = 0;
+            if (read(c.fd_, &value, sizeof(value)) == sizeof(value)) f(c.name_, value / per);
+        }
+    }
+
+private:
+    struct counter {
+        string name_;
+        int fd_;
+    };
+
+    static uint64_t cacheevent(uint64_t cache) {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+    void open(const char* name, uint32_t type, uint64_t config) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd >= 0) counters_.push_back(counter{ name, fd });
+    }
+
+    vector<counter> counters_;
+};
+
+#endif // PERFCOUNTERS_H
@@ -0,0 +1,92 @@
+// Crash-recovery cost: a manager with recovery enabled takes a book to
+// `orders` resting orders (forking a snapshot once it gets there), runs `tail`
+// more commands into the WAL, and shuts down. A fresh manager then measures
+// startup from snapshot + WAL tail, and from the WAL alone.
+//
+//   recovery_bench [orders] [tail] [path-prefix]
+#include "../orderbookmanager.h"
+
+static void removefiles(const string& prefix) {
+    ::unlink((prefix + ".0.wal").c_str());
+    ::unlink((prefix + ".0.snapshot").c_str());
+    ::unlink((prefix + ".0.snapshot.tmp").c_str());
+}
+
+// Submit, draining events whenever the ring is full. Returns status events seen.
+static size_t submitall(OrderbookManager& books, const vector<ordercommand>& cmds) {
+    size_t statuses = 0;
+    auto count = [&](const execevent& ev) { statuses += ev.type_ != eventtype::Fill && ev.type_ != eventtype::SelfTrade; };
+    for (const ordercommand& cmd : cmds)
+        while (!books.submit(cmd)) books.pollevents(count);
+    // Every command ends with exactly one status event.
+    while (statuses < cmds.size()) {
+        if (books.pollevents(count) == 0) this_thread::yield();
+    }
+    return statuses;
+}
+
+static void restart(const string& prefix, size_t orders, size_t expected, const char* what) {
+    OrderbookManager books(1);
+    books.addsymbol("BENCH", {}, orders);
+    recoverystats r = books.enablerecovery(prefix, 0);
+    size_t resting = books.getbook(0).size();
+    cout << what << ": " << r.snapshotorders << " orders from snapshot + " << r.replayed << " WAL records in "
+        << fixed << setprecision(1) << r.seconds * 1e3 << " ms, " << resting << " resting"
+        << (resting == expected ? "" : " (MISMATCH)") << endl;
+}
+
+int main(int argc, char** argv) {
+    size_t orders = argc > 1 ? stoull(argv[1]) : 2000000;
+    size_t tail = argc > 2 ? stoull(argv[2]) : 500000;
+    string prefix = argc > 3 ? argv[3] : "recovery_bench";
+    removefiles(prefix);
+
+    // Passive orders on 1000 levels a side, then a tail of cancels and new orders.
+    mt19937_64 rng(1);
+    vector<ordercommand> build, more;
+    build.reserve(orders);
+    for (size_t i = 0; i < orders; ++i) {
+        Side side = i % 2 ? Side::Buy : Side::Sell;
+        int64_t offset = 1 + (int64_t)(rng() % 1000);
+        build.push_back(ordercommand{ commandtype::New, ordertype::Limit, side, 0, OrderId(i + 1),
+            Price(side == Side::Buy ? 100000 - offset : 100000 + offset), Qty(100) });
+    }
+    for (size_t i = 0; i < tail; ++i) {
+        if (i % 2) {
+            more.push_back(ordercommand{ commandtype::Cancel, ordertype::Limit, Side::Buy, 0,
+                OrderId(1 + rng() % orders), Price(), Qty() });
+        }
+        else {
+            Side side = rng() % 2 ? Side::Buy : Side::Sell;
+            int64_t offset = 1 + (int64_t)(rng() % 1000);
+            more.push_back(ordercommand{ commandtype::New, ordertype::Limit, side, 0, OrderId(orders + i + 1),
+                Price(side == Side::Buy ? 100000 - offset : 100000 + offset), Qty(100) });
+        }
+    }
+
+    size_t resting;
+    {
+        OrderbookManager books(1);
+        books.addsymbol("BENCH", {}, orders);
+        books.enablerecovery(prefix, orders);
+        books.start();
+        auto start = chrono::steady_clock::now();
+        submitall(books, build);
+        submitall(books, more);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        books.stop();
+        books.waitsnapshots();
+        resting = books.getbook(0).size();
+        cout << "session: " << build.size() + more.size() << " commands acked after group commit in "
+            << fixed << setprecision(1) << seconds * 1e3 << " ms (" << setprecision(2)
+            << (build.size() + more.size()) / seconds / 1e6 << " M cmd/s), " << resting << " resting" << endl;
+        cout << "snapshot: " << books.snapshotswritten(0) << " written, fork paused matching for "
+            << setprecision(1) << books.snapshotpausens(0) / 1e3 << " us" << endl;
+    }
+
+    restart(prefix, orders, resting, "restart from snapshot + WAL");
+    ::unlink((prefix + ".0.snapshot").c_str());
+    restart(prefix, orders, resting, "restart from WAL only");
+    removefiles(prefix);
+    return 0;
+}
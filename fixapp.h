@@ -1,20 +1,51 @@
 #ifndef FIXAPP_H
 #define FIXAPP_H
 
-#include "Orderbook.h"
+#include "orderbookmanager.h"
+#include "fixparser.h"
+#include "fixids.h"
+#include "risk.h"
 #include "quickfix/Application.h"
 #include "quickfix/MessageCracker.h"
 #include "quickfix/fix42/NewOrderSingle.h"
 #include "quickfix/fix42/ExecutionReport.h"
+#include "quickfix/fix42/OrderCancelRequest.h"
+#include "quickfix/fix42/OrderCancelReplaceRequest.h"
+#include "quickfix/fix42/OrderCancelReject.h"
 #include <iostream>
+#include <map>
 #include <stdexcept>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 class FixApp : public FIX::Application, public FIX::MessageCracker {
 public:
-    FixApp(Orderbook& ob) : orderbook_(ob) {}
+    // Each session is one risk account, with its entry in sessionLimits or
+    // defaultLimits. Symbols must all be registered with books first. Orders
+    // get engine IDs from firstOrderId upwards, whatever their ClOrdIDs; after
+    // recovery, start past recoverystats::lastid.
+    FixApp(OrderbookManager& books, std::map<FIX::SessionID, risklimits> sessionLimits = {},
+        risklimits defaultLimits = {}, OrderId firstOrderId = OrderId(1))
+        : books_(books), nextOrderId_(firstOrderId), sessionLimits_(std::move(sessionLimits)),
+          defaultLimits_(defaultLimits), risk_(books.bookcount()) {
+        // Fields that are the same on every engine-driven report are set once here.
+        reportTemplate_.set(FIX::ExecTransType(FIX::ExecTransType_NEW));
+        egress_ = std::thread([this] { pumpevents(); });
+    }
+    ~FixApp() {
+        running_ = false;
+        egress_.join();
+    }
 
     void onCreate(const FIX::SessionID& sessionID) override {
         std::cout << "Session created: " << sessionID << std::endl;
+        std::lock_guard<std::mutex> lock(ordersMutex_);
+        accountFor(sessionID);
     }
 
     void onLogon(const FIX::SessionID& sessionID) override {
@@ -33,46 +64,517 @@ public:
     }
 
     void fromApp(const FIX::Message& message, const FIX::SessionID& sessionID) override {
+        ingressStamp() = latencyclock::now();
         crack(message, sessionID);
     }
 
     // Handle NewOrderSingle messages.
     void onMessage(const FIX42::NewOrderSingle& orderMsg, const FIX::SessionID& sessionID) override {
-        std::cout << "Received NewOrderSingle" << std::endl;
         FIX::ClOrdID clOrdID;
         FIX::Side side;
         FIX::Price price;
         FIX::OrderQty orderQty;
+        FIX::Symbol symbol;
+        FIX::OrdType ordType(FIX::OrdType_LIMIT);
+        FIX::TimeInForce timeInForce(FIX::TimeInForce_DAY);
+        FIX::StopPx stopPx;
+        FIX::MaxFloor maxFloor;
         orderMsg.get(clOrdID);
         orderMsg.get(side);
-        orderMsg.get(price);
         orderMsg.get(orderQty);
+        orderMsg.get(symbol);
+        if (orderMsg.isSet(ordType)) orderMsg.get(ordType);
+        if (orderMsg.isSet(timeInForce)) orderMsg.get(timeInForce);
+
+        ordertype type;
+        if (!toOrderType(ordType.getValue(), timeInForce.getValue(), type)) {
+            sendNewOrderReject(sessionID, clOrdID.getString(), symbol.getValue(), side.getValue(),
+                orderReject{ FIX::OrdRejReason_OTHER, "Unsupported order type" });
+            return;
+        }
+        Price pr = Price::none();
+        Price stop = Price::none();
+        bool exact = true;
+        if (type != ordertype::Market && type != ordertype::Stop) {
+            orderMsg.get(price);
+            exact = Price::fromdoubleexact(price.getValue(), pr);
+        }
+        if (type == ordertype::Stop || type == ordertype::StopLimit) {
+            orderMsg.get(stopPx);
+            exact = exact && Price::fromdoubleexact(stopPx.getValue(), stop);
+        }
+        if (!exact) {
+            sendNewOrderReject(sessionID, clOrdID.getString(), symbol.getValue(), side.getValue(), offTickReject());
+            return;
+        }
+        Qty display(0);
+        if (orderMsg.isSet(maxFloor)) {
+            orderMsg.get(maxFloor);
+            display = Qty(std::llround(maxFloor.getValue()));
+        }
+        Qty qty(std::llround(orderQty.getValue()));
+        orderReject reject;
+        if (!submitNewOrder(sessionID, clOrdID.getString(), symbol.getValue(), side.getValue(), pr, qty, type, reject, stop, display))
+            sendNewOrderReject(sessionID, clOrdID.getString(), symbol.getValue(), side.getValue(), reject);
+    }
+
+    // Fast inbound path for a transport that has the raw bytes of an incoming
+    // message: a NewOrderSingle is decoded in place by parsenewordersingle
+    // instead of through QuickFIX's field objects. Prices finer than the
+    // engine's price unit, bad field values and missing fields are rejected
+    // like any other refused order; a message with a bad checksum is garbled
+    // and dropped. Returns false if the bytes are incomplete, badly framed or
+    // not a NewOrderSingle, so the caller can hand them to QuickFIX.
+    bool onRawNewOrderSingle(const char* data, size_t len, const FIX::SessionID& sessionID) {
+        ingressStamp() = latencyclock::now();
+        fixneworder order;
+        fixparsestatus status = parsenewordersingle(data, len, order);
+        if (status == fixparsestatus::Incomplete || status == fixparsestatus::BadFraming
+            || status == fixparsestatus::NotNewOrder)
+            return false;
+        if (status == fixparsestatus::BadChecksum) return true;
+        std::string symbol(order.symbol());
+        char side = order.side_ == Side::Buy ? FIX::Side_BUY : FIX::Side_SELL;
+        orderReject reject;
+        if (status == fixparsestatus::Ok) {
+            if (submitNewOrder(sessionID, order.clordid(), symbol, side, order.price_, order.quantity_, order.ordertype_,
+                    reject, order.stop_, order.display_))
+                return true;
+        }
+        else if (status == fixparsestatus::OffTick) reject = offTickReject();
+        else if (status == fixparsestatus::MissingField) reject = orderReject{ FIX::OrdRejReason_OTHER, "Missing required field" };
+        else reject = orderReject{ FIX::OrdRejReason_OTHER, "Invalid field value" };
+        sendNewOrderReject(sessionID, order.clordid(), symbol, side, reject);
+        return true;
+    }
+
+    // Handle OrderCancelRequest messages.
+    void onMessage(const FIX42::OrderCancelRequest& cancelMsg, const FIX::SessionID& sessionID) override {
+        FIX::OrigClOrdID origClOrdID;
+        FIX::ClOrdID clOrdID;
+        cancelMsg.get(origClOrdID);
+        cancelMsg.get(clOrdID);
+
+        ordercommand cmd{ commandtype::Cancel, ordertype::Limit, Side::Buy, -1, OrderId(), Price(), Qty() };
+        OrderId orderID;
+        const char* text = "";
+        if (!claimOrder(sessionID, origClOrdID.getString(), clOrdID.getString(), cmd, orderID, text))
+            sendCancelReject(sessionID, clOrdID.getString(), origClOrdID.getString(), orderID,
+                FIX::CxlRejResponseTo_ORDER_CANCEL_REQUEST, text);
+    }
+
+    // Handle OrderCancelReplaceRequest messages. Only price and quantity can be
+    // changed; a same-price quantity reduction keeps the order's queue position.
+    // Price may be left out only for a stop order, which keeps its StopPx.
+    void onMessage(const FIX42::OrderCancelReplaceRequest& replaceMsg, const FIX::SessionID& sessionID) override {
+        FIX::OrigClOrdID origClOrdID;
+        FIX::ClOrdID clOrdID;
+        FIX::Price price;
+        FIX::OrderQty orderQty;
+        replaceMsg.get(origClOrdID);
+        replaceMsg.get(clOrdID);
+        replaceMsg.get(orderQty);
 
-        int id = std::stoi(clOrdID.getString());
-        int pr = price.getValue();
-        int qty = orderQty.getValue();
-        Side s = (side.getValue() == FIX::Side_BUY) ? Side::Buy : Side::Sell;
+        ordercommand cmd{ commandtype::Modify, ordertype::Limit, Side::Buy, -1, OrderId(),
+            Price::none(), Qty(std::llround(orderQty.getValue())) };
+        if (replaceMsg.isSet(price)) {
+            replaceMsg.get(price);
+            if (!Price::fromdoubleexact(price.getValue(), cmd.price_)) {
+                sendCancelReject(sessionID, clOrdID.getString(), origClOrdID.getString(), OrderId(),
+                    FIX::CxlRejResponseTo_ORDER_CANCEL_REPLACE_REQUEST, offTickReject().text);
+                return;
+            }
+        }
+        OrderId orderID;
+        const char* text = "";
+        if (!claimOrder(sessionID, origClOrdID.getString(), clOrdID.getString(), cmd, orderID, text))
+            sendCancelReject(sessionID, clOrdID.getString(), origClOrdID.getString(), orderID,
+                FIX::CxlRejResponseTo_ORDER_CANCEL_REPLACE_REQUEST, text);
+    }
 
-        // Create internal Order object.
-        orderptr newOrder = std::make_shared<Order>(ordertype::Limit, id, s, pr, qty);
-        orderbook_.addorder(newOrder);
+    // Latency from an engine event to its ExecutionReport being sent, and from
+    // the inbound message to that report. Safe from any thread.
+    void writeStats(std::ostream& os) const {
+        writesummary(os, "fix outbound", outboundLatency_.summary());
+        writesummary(os, "fix total", totalLatency_.summary());
+    }
 
-        // Send back an ExecutionReport as an acknowledgment.
+private:
+    // When the message being handled on this session thread arrived.
+    static uint64_t& ingressStamp() {
+        static thread_local uint64_t stamp = 0;
+        return stamp;
+    }
+
+    // Engine order type for an OrdType/TimeInForce pair: market orders and IOC
+    // or FOK limits never rest. Returns false for order types the engine does
+    // not trade.
+    static bool toOrderType(char ordType, char timeInForce, ordertype& out) {
+        if (ordType == FIX::OrdType_MARKET) out = ordertype::Market;
+        else if (ordType == FIX::OrdType_STOP) out = ordertype::Stop;
+        else if (ordType == FIX::OrdType_STOP_LIMIT) out = ordertype::StopLimit;
+        else if (ordType != FIX::OrdType_LIMIT) return false;
+        else if (timeInForce == FIX::TimeInForce_IMMEDIATE_OR_CANCEL) out = ordertype::fillandkill;
+        else if (timeInForce == FIX::TimeInForce_FILL_OR_KILL) out = ordertype::fillorkill;
+        else out = ordertype::Limit;
+        return true;
+    }
+
+    // Why a new order was refused, for its reject ExecutionReport.
+    struct orderReject {
+        int reason = FIX::OrdRejReason_OTHER;
+        const char* text = "";
+    };
+
+    // A price that is not a whole number of the engine's price units is
+    // refused rather than rounded to a price the client did not ask for.
+    static orderReject offTickReject() { return orderReject{ FIX::OrdRejReason_OTHER, "Price finer than the price unit" }; }
+
+    // Risk account of a session, created on first use along with the
+    // session's ClOrdID table.
+    int accountFor(const FIX::SessionID& sessionID) {
+        auto it = accounts_.find(sessionID);
+        if (it != accounts_.end()) return it->second;
+        auto limits = sessionLimits_.find(sessionID);
+        int account = risk_.addaccount(limits == sessionLimits_.end() ? defaultLimits_ : limits->second);
+        accounts_.emplace(sessionID, account);
+        clOrdIds_.emplace_back();
+        return account;
+    }
+
+    // Decimal text of an engine order ID or report sequence number. It fits
+    // std::string's inline buffer, so handing it to a field does not allocate.
+    static std::string idText(uint64_t value) {
+        char buf[20];
+        return std::string(buf, formatid(buf, value));
+    }
+    std::string nextExecId() { return idText(execSeq_.fetch_add(1, std::memory_order_relaxed) + 1); }
+
+    // Hand a new order to the shard that owns its symbol's book under the next
+    // engine order ID. It passes the session's pre-trade risk checks and is
+    // registered first, so its events can never arrive for an unknown order;
+    // the New ack is sent by the egress thread ahead of any fills. Returns
+    // false, with the reason in reject, for a ClOrdID that is too long or
+    // already live on the session, an unknown symbol, risk limit, price or
+    // quantity off the instrument's tick/lot size, or full matching queue.
+    // Stop orders carry their stop price and icebergs their display quantity.
+    bool submitNewOrder(const FIX::SessionID& sessionID, std::string_view clOrdID,
+        const std::string& symbol, char side, Price price, Qty qty, ordertype type, orderReject& reject,
+        Price stop = Price::none(), Qty display = Qty(0)) {
+        if (!clordid::fits(clOrdID)) {
+            reject = orderReject{ FIX::OrdRejReason_OTHER, "Invalid ClOrdID" };
+            return false;
+        }
+        int book = books_.findsymbol(symbol);
+        if (book < 0) {
+            reject = orderReject{ FIX::OrdRejReason_UNKNOWN_SYMBOL, "Unknown symbol" };
+            return false;
+        }
+        Side engineSide = side == FIX::Side_BUY ? Side::Buy : Side::Sell;
+        int account;
+        Price valued;
+        OrderId id;
+        {
+            std::lock_guard<std::mutex> lock(ordersMutex_);
+            account = accountFor(sessionID);
+            riskresult risk = risk_.checknew(account, book, engineSide, price, qty, nowns());
+            if (risk != riskresult::Ok) {
+                reject = orderReject{ FIX::OrdRejReason_ORDER_EXCEEDS_LIMIT, riskreason(risk) };
+                return false;
+            }
+            valued = price == Price::none() ? risk_.reference(book) : price;
+            id = nextOrderId_;
+            if (!clOrdIds_[account].insert(clOrdID, id)) {
+                reject = orderReject{ FIX::OrdRejReason_DUPLICATE_ORDER, "Duplicate order" };
+                return false;
+            }
+            nextOrderId_ = OrderId(id.value() + 1);
+            orders_.emplace(id, clientorder{ sessionID, clordid(clOrdID), clordid(), book, side, qty,
+                Qty(0), 0, account, valued });
+            risk_.opened(account, book, engineSide, valued, qty);
+        }
+        // The session's risk account doubles as its self-trade prevention owner.
+        ordercommand cmd{ commandtype::New, type, engineSide, book, id, price, qty, (uint32_t)account + 1, ingressStamp(), stop, display };
+        if (books_.submit(cmd)) return true;
+        std::lock_guard<std::mutex> lock(ordersMutex_);
+        risk_.release(account, book, engineSide, valued, qty);
+        risk_.closed(account);
+        orders_.erase(id);
+        clOrdIds_[account].erase(clOrdID);
+        reject = orderReject{ FIX::OrdRejReason_OTHER, "Invalid price or quantity, or engine busy" };
+        return false;
+    }
+
+    // A refused order never got an engine ID, so its OrderID is NONE.
+    void sendNewOrderReject(const FIX::SessionID& sessionID, std::string_view clOrdID,
+        const std::string& symbol, char side, const orderReject& reject) {
         FIX42::ExecutionReport execReport;
-        execReport.set(FIX::OrderID("EX" + clOrdID.getString()));
-        execReport.set(FIX::ExecID("E" + clOrdID.getString()));
-        execReport.set(FIX::ExecType('0')); // New
-        execReport.set(FIX::OrdStatus('0')); // New
-        execReport.set(FIX::Symbol("STOCK"));
-        execReport.set(side);
-        execReport.set(FIX::LeavesQty(orderQty));
+        execReport.set(FIX::OrderID("NONE"));
+        execReport.set(FIX::ExecID(nextExecId()));
+        execReport.set(FIX::ClOrdID(std::string(clOrdID)));
+        execReport.set(FIX::ExecTransType(FIX::ExecTransType_NEW));
+        execReport.set(FIX::ExecType(FIX::ExecType_REJECTED));
+        execReport.set(FIX::OrdStatus(FIX::OrdStatus_REJECTED));
+        execReport.set(FIX::Symbol(symbol));
+        execReport.set(FIX::Side(side));
+        execReport.set(FIX::LeavesQty(0));
         execReport.set(FIX::CumQty(0));
+        execReport.set(FIX::AvgPx(0));
+        execReport.set(FIX::OrdRejReason(reject.reason));
+        execReport.set(FIX::Text(reject.text));
         FIX::Session::sendToTarget(execReport, sessionID);
     }
 
-private:
-    Orderbook& orderbook_;
+    // Per-order state needed to report back to the owning session, keyed by
+    // engine order ID, which is also the OrderID(37) reported.
+    struct clientorder {
+        FIX::SessionID session_;
+        clordid clOrdID_;               // Current ClOrdID (changes on replace).
+        clordid pendingClOrdID_;        // ClOrdID of an in-flight cancel/replace.
+        int book_;
+        char side_;
+        Qty orderQty_;
+        Qty cumQty_{ 0 };
+        double notional_ = 0;
+        int account_;
+        Price riskPrice_;               // Price the open quantity is valued at for risk.
+    };
+
+    // Resolve OrigClOrdID to a live order of this session, mark the cancel/replace
+    // as in flight and submit it. Only one cancel/replace may be pending per order.
+    // A replace must pass the session's risk checks; cancels only reduce risk
+    // and are never throttled.
+    // orderID is left as OrderId() (reported as NONE) if the order is unknown.
+    bool claimOrder(const FIX::SessionID& sessionID, const std::string& origClOrdID,
+        const std::string& clOrdID, ordercommand& cmd, OrderId& orderID, const char*& text) {
+        std::lock_guard<std::mutex> lock(ordersMutex_);
+        clordidtable& ids = clOrdIds_[accountFor(sessionID)];
+        const OrderId* id = ids.find(origClOrdID);
+        if (id == nullptr) return false;
+        orderID = *id;
+        clientorder& st = orders_.at(orderID);
+        if (!st.pendingClOrdID_.empty() || st.cumQty_ == st.orderQty_)
+            return false;
+        // The new ClOrdID is reserved for the order now, so no other message
+        // can take it while the request is in flight.
+        if (!clordid::fits(clOrdID) || !ids.insert(clOrdID, orderID)) {
+            text = "Invalid or duplicate ClOrdID";
+            return false;
+        }
+        cmd.book_ = st.book_;
+        cmd.id_ = orderID;
+        cmd.side_ = st.side_ == FIX::Side_BUY ? Side::Buy : Side::Sell;
+        cmd.stamp_ = ingressStamp();
+        if (cmd.type_ == commandtype::Modify) {
+            // A stop replaced without a price stays valued as before.
+            Price price = cmd.price_ == Price::none() ? st.riskPrice_ : cmd.price_;
+            riskresult risk = risk_.checkreplace(st.account_, st.book_, cmd.side_, st.riskPrice_,
+                st.orderQty_ - st.cumQty_, price, cmd.quantity_ - st.cumQty_, nowns());
+            if (risk != riskresult::Ok) {
+                ids.erase(clOrdID);
+                text = riskreason(risk);
+                return false;
+            }
+        }
+        if (!books_.submit(cmd)) {
+            ids.erase(clOrdID);
+            return false;
+        }
+        st.pendingClOrdID_ = clordid(clOrdID);
+        return true;
+    }
+
+    void sendCancelReject(const FIX::SessionID& sessionID, std::string_view clOrdID,
+        std::string_view origClOrdID, OrderId orderID, char responseTo, const char* text = "") {
+        FIX42::OrderCancelReject reject;
+        reject.set(FIX::OrderID(orderID == OrderId() ? std::string("NONE") : idText(orderID.value())));
+        reject.set(FIX::ClOrdID(std::string(clOrdID)));
+        reject.set(FIX::OrigClOrdID(std::string(origClOrdID)));
+        reject.set(FIX::OrdStatus(FIX::OrdStatus_REJECTED));
+        reject.set(FIX::CxlRejResponseTo(responseTo));
+        if (*text) reject.set(FIX::Text(text));
+        FIX::Session::sendToTarget(reject, sessionID);
+    }
+
+    // Egress thread: drains execution events coming back from the matching
+    // shards. A shard pushes all events for one inbound message back to back,
+    // so a poll normally picks them up together; they are formatted first and
+    // then sent as one batch.
+    void pumpevents() {
+        while (running_.load(std::memory_order_relaxed)) {
+            size_t n = books_.pollevents([this](const execevent& ev, const eventtiming& timing) { onEvent(ev, timing); });
+            if (n == 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+                continue;
+            }
+            flushReports();
+        }
+    }
+
+    // Each report's latency is taken once it has been handed to its session.
+    void flushReports() {
+        for (size_t i = 0; i < pending_; ++i) {
+            FIX::Session::sendToTarget(reports_[i], targets_[i]);
+            uint64_t sent = latencyclock::now();
+            const eventtiming& t = timings_[i];
+            if (sent > t.emitted_) outboundLatency_.record(latencyclock::tons(sent - t.emitted_));
+            if (t.ingress_ && sent > t.ingress_) totalLatency_.record(latencyclock::tons(sent - t.ingress_));
+        }
+        pending_ = 0;
+    }
+
+    // Next reusable report slot. Slots are copies of reportTemplate_ reused
+    // across batches, so steady-state formatting only overwrites field values.
+    FIX42::ExecutionReport& nextReport(const clientorder& st, const eventtiming& timing) {
+        if (pending_ == reports_.size()) {
+            reports_.push_back(reportTemplate_);
+            targets_.emplace_back();
+            timings_.emplace_back();
+        }
+        targets_[pending_] = st.session_;
+        timings_[pending_] = timing;
+        return reports_[pending_++];
+    }
+
+    // Turn an engine event into an ExecutionReport (or OrderCancelReject).
+    void onEvent(const execevent& ev, const eventtiming& timing) {
+        std::lock_guard<std::mutex> lock(ordersMutex_);
+        if (ev.type_ == eventtype::Fill) risk_.trade(ev.book_, ev.price_);
+        auto it = orders_.find(ev.id_);
+        if (it == orders_.end()) return;
+        clientorder& st = it->second;
+
+        if (ev.type_ == eventtype::CancelRejected || ev.type_ == eventtype::ReplaceRejected) {
+            flushReports();
+            sendCancelReject(st.session_, st.pendingClOrdID_.view(), st.clOrdID_.view(), ev.id_,
+                ev.type_ == eventtype::CancelRejected ? FIX::CxlRejResponseTo_ORDER_CANCEL_REQUEST
+                                                      : FIX::CxlRejResponseTo_ORDER_CANCEL_REPLACE_REQUEST);
+            clOrdIds_[st.account_].erase(st.pendingClOrdID_.view());
+            st.pendingClOrdID_.clear();
+            if (st.cumQty_ == st.orderQty_) forgetOrder(it);
+            return;
+        }
+
+        clordid origClOrdID;
+        char execType = FIX::ExecType_NEW;
+        char status = FIX::OrdStatus_NEW;
+        Side side = st.side_ == FIX::Side_BUY ? Side::Buy : Side::Sell;
+        Qty open = st.orderQty_ - st.cumQty_;
+        switch (ev.type_) {
+        case eventtype::Fill:
+            risk_.fill(st.account_, st.book_, side, st.riskPrice_, ev.quantity_, ev.price_);
+            st.cumQty_ += ev.quantity_;
+            st.notional_ += ev.price_.todouble() * ev.quantity_.value();
+            status = st.cumQty_ == st.orderQty_ ? FIX::OrdStatus_FILLED : FIX::OrdStatus_PARTIALLY_FILLED;
+            execType = status;
+            break;
+        case eventtype::Rejected:
+            execType = status = FIX::OrdStatus_REJECTED;
+            risk_.release(st.account_, st.book_, side, st.riskPrice_, open);
+            st.orderQty_ = st.cumQty_;
+            break;
+        case eventtype::Cancelled:
+            execType = status = FIX::OrdStatus_CANCELED;
+            risk_.release(st.account_, st.book_, side, st.riskPrice_, open);
+            st.orderQty_ = st.cumQty_;
+            break;
+        case eventtype::Expired:
+            // Unfilled remainder of a market, IOC, FOK or triggered stop order.
+            execType = status = FIX::OrdStatus_CANCELED;
+            risk_.release(st.account_, st.book_, side, st.riskPrice_, open);
+            st.orderQty_ = st.cumQty_;
+            break;
+        case eventtype::SelfTrade:
+            // Self-trade prevention took open quantity off the order: a
+            // restatement, or a cancel if nothing is left.
+            risk_.release(st.account_, st.book_, side, st.riskPrice_, ev.quantity_);
+            st.orderQty_ -= ev.quantity_;
+            if (st.orderQty_ == st.cumQty_) execType = status = FIX::OrdStatus_CANCELED;
+            else {
+                execType = FIX::ExecType_RESTATED;
+                status = st.cumQty_ > Qty(0) ? FIX::OrdStatus_PARTIALLY_FILLED : FIX::OrdStatus_NEW;
+            }
+            break;
+        case eventtype::Triggered:
+            // A stop order's trigger was reached; its fills follow.
+            execType = FIX::ExecType_TRIGGERED_OR_ACTIVATED_BY_SYSTEM;
+            status = st.cumQty_ > Qty(0) ? FIX::OrdStatus_PARTIALLY_FILLED : FIX::OrdStatus_NEW;
+            break;
+        case eventtype::Replaced:
+            execType = status = FIX::OrdStatus_REPLACED;
+            risk_.release(st.account_, st.book_, side, st.riskPrice_, open);
+            st.orderQty_ = ev.quantity_;
+            if (ev.price_ != Price::none()) st.riskPrice_ = ev.price_;
+            risk_.reserve(st.account_, st.book_, side, st.riskPrice_, st.orderQty_ - st.cumQty_);
+            break;
+        default:
+            break;
+        }
+        if (ev.type_ == eventtype::Cancelled || ev.type_ == eventtype::Replaced) {
+            // The ClOrdID reserved by claimOrder becomes the order's own.
+            clordidtable& ids = clOrdIds_[st.account_];
+            assert(ids.find(st.pendingClOrdID_.view()) && *ids.find(st.pendingClOrdID_.view()) == ev.id_);
+            origClOrdID = st.clOrdID_;
+            ids.erase(st.clOrdID_.view());
+            st.clOrdID_ = st.pendingClOrdID_;
+            st.pendingClOrdID_.clear();
+        }
+        Qty leaves = st.orderQty_ - st.cumQty_;
+        if (open > Qty(0) && leaves == Qty(0)) risk_.closed(st.account_);
+
+        FIX42::ExecutionReport& report = nextReport(st, timing);
+        report.set(FIX::OrderID(idText(ev.id_.value())));
+        report.set(FIX::ExecID(nextExecId()));
+        report.set(FIX::ClOrdID(std::string(st.clOrdID_.view())));
+        if (origClOrdID.empty()) report.removeField(FIX::FIELD::OrigClOrdID);
+        else report.set(FIX::OrigClOrdID(std::string(origClOrdID.view())));
+        report.set(FIX::ExecType(execType));
+        report.set(FIX::OrdStatus(status));
+        report.set(FIX::Symbol(books_.symbolname(st.book_)));
+        report.set(FIX::Side(st.side_));
+        bool fill = ev.type_ == eventtype::Fill;
+        report.set(FIX::LastShares(fill ? ev.quantity_.value() : 0));
+        report.set(FIX::LastPx(fill ? ev.price_.todouble() : 0));
+        report.set(FIX::LeavesQty(leaves.value()));
+        report.set(FIX::CumQty(st.cumQty_.value()));
+        report.set(FIX::AvgPx(st.cumQty_ > Qty(0) ? st.notional_ / st.cumQty_.value() : 0));
+
+        // A done order is kept while a cancel/replace is in flight so the
+        // engine's reject for it can still be routed.
+        if (leaves == Qty(0) && st.pendingClOrdID_.empty()) forgetOrder(it);
+    }
+
+    void forgetOrder(std::unordered_map<OrderId, clientorder>::iterator it) {
+        clordidtable& ids = clOrdIds_[it->second.account_];
+        ids.erase(it->second.clOrdID_.view());
+        if (!it->second.pendingClOrdID_.empty()) ids.erase(it->second.pendingClOrdID_.view());
+        orders_.erase(it);
+    }
+
+    OrderbookManager& books_;
+    std::atomic<bool> running_{ true };
+
+    // Order and risk state, shared by the session threads and the egress thread.
+    std::mutex ordersMutex_;
+    OrderId nextOrderId_;
+    std::unordered_map<OrderId, clientorder> orders_;
+    std::deque<clordidtable> clOrdIds_;     // Per risk account (session): current and pending ClOrdIDs -> order ID.
+    std::map<FIX::SessionID, risklimits> sessionLimits_;
+    risklimits defaultLimits_;
+    riskengine risk_;
+    std::map<FIX::SessionID, int> accounts_;
+    std::atomic<uint64_t> execSeq_{ 0 };    // ExecID sequence; rejects are numbered from session threads.
+
+    // Egress-thread-only state.
+    FIX42::ExecutionReport reportTemplate_;
+    std::vector<FIX42::ExecutionReport> reports_;
+    std::vector<FIX::SessionID> targets_;
+    std::vector<eventtiming> timings_;
+    size_t pending_ = 0;
+    latencyhistogram outboundLatency_;  // Event emitted by the shard -> report sent.
+    latencyhistogram totalLatency_;     // Message received -> report sent.
     FIX::SessionID sessionID_;
+    std::thread egress_;
 };
 
 #endif // FIXAPP_H
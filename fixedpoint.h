@@ -0,0 +1,110 @@
+#ifndef FIXEDPOINT_H
+#define FIXEDPOINT_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// Decimal places of the engine's price unit. Every price in the engine is an
+// integer number of 10^-ORDERBOOK_PRICE_DECIMALS; an instrument's tick is a
+// whole number of those units. Override at build time to trade finer prices.
+#ifndef ORDERBOOK_PRICE_DECIMALS
+#define ORDERBOOK_PRICE_DECIMALS 4
+#endif
+
+// Integer wrapper that only converts explicitly, so a price can never be passed
+// where a quantity or an ID is expected. Compiles down to the bare integer.
+template <class Tag, class Rep>
+class strongvalue {
+public:
+    using rep = Rep;
+    constexpr strongvalue() = default;
+    constexpr explicit strongvalue(Rep v) : v_(v) {}
+    constexpr Rep value() const { return v_; }
+
+    friend constexpr bool operator==(const Tag& a, const Tag& b) { return a.value() == b.value(); }
+    friend constexpr bool operator!=(const Tag& a, const Tag& b) { return a.value() != b.value(); }
+    friend constexpr bool operator<(const Tag& a, const Tag& b) { return a.value() < b.value(); }
+    friend constexpr bool operator>(const Tag& a, const Tag& b) { return a.value() > b.value(); }
+    friend constexpr bool operator<=(const Tag& a, const Tag& b) { return a.value() <= b.value(); }
+    friend constexpr bool operator>=(const Tag& a, const Tag& b) { return a.value() >= b.value(); }
+
+protected:
+    Rep v_ = 0;
+};
+
+// Price in engine units (see ORDERBOOK_PRICE_DECIMALS).
+class Price : public strongvalue<Price, int64_t> {
+public:
+    using strongvalue::strongvalue;
+    static constexpr int decimals = ORDERBOOK_PRICE_DECIMALS;
+    static constexpr int64_t scale = [] {
+        int64_t s = 1;
+        for (int i = 0; i < decimals; ++i) s *= 10;
+        return s;
+    }();
+
+    // Nearest engine price to a decimal value, e.g. a FIX Price field.
+    static Price fromdouble(double d) { return Price(llround(d * scale)); }
+    // Same for an order's price, which must not be rounded: false unless d is
+    // a whole number of price units, give or take the double's own error.
+    static bool fromdoubleexact(double d, Price& out) {
+        double scaled = d * scale;
+        if (!(fabs(scaled) < 0x1p62)) return false;
+        double whole = nearbyint(scaled);
+        if (fabs(scaled - whole) > fabs(scaled) * 4 * numeric_limits<double>::epsilon()) return false;
+        out = Price((int64_t)whole);
+        return true;
+    }
+    double todouble() const { return double(v_) / scale; }
+
+    // Marks an order that has no limit price.
+    static constexpr Price none() { return Price(numeric_limits<int64_t>::min()); }
+
+    friend constexpr Price operator+(Price a, Price b) { return Price(a.v_ + b.v_); }
+    friend constexpr Price operator-(Price a, Price b) { return Price(a.v_ - b.v_); }
+    friend constexpr Price operator*(Price a, int64_t n) { return Price(a.v_ * n); }
+    // Whole ticks between two prices.
+    friend constexpr int64_t operator/(Price a, Price b) { return a.v_ / b.v_; }
+    friend constexpr Price operator%(Price a, Price b) { return Price(a.v_ % b.v_); }
+
+    friend ostream& operator<<(ostream& os, Price p) {
+        int64_t v = p.v_;
+        if (v < 0) {
+            os << '-';
+            v = -v;
+        }
+        os << v / scale;
+        if (decimals > 0) {
+            string frac = to_string(v % scale);
+            os << '.' << string(decimals - frac.size(), '0') << frac;
+        }
+        return os;
+    }
+};
+
+// Order or fill quantity, in shares/contracts.
+class Qty : public strongvalue<Qty, int64_t> {
+public:
+    using strongvalue::strongvalue;
+    friend constexpr Qty operator+(Qty a, Qty b) { return Qty(a.v_ + b.v_); }
+    friend constexpr Qty operator-(Qty a, Qty b) { return Qty(a.v_ - b.v_); }
+    friend constexpr Qty operator%(Qty a, Qty b) { return Qty(a.v_ % b.v_); }
+    Qty& operator+=(Qty b) { v_ += b.v_; return *this; }
+    Qty& operator-=(Qty b) { v_ -= b.v_; return *this; }
+    friend ostream& operator<<(ostream& os, Qty q) { return os << q.v_; }
+};
+
+class OrderId : public strongvalue<OrderId, uint64_t> {
+public:
+    using strongvalue::strongvalue;
+    friend ostream& operator<<(ostream& os, OrderId id) { return os << id.v_; }
+};
+
+namespace std {
+template <>
+struct hash<OrderId> {
+    size_t operator()(OrderId id) const noexcept { return hash<uint64_t>()(id.value()); }
+};
+}
+
+#endif // FIXEDPOINT_H
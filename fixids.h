@@ -0,0 +1,166 @@
+#ifndef FIXIDS_H
+#define FIXIDS_H
+
+#include <bits/stdc++.h>
+#include "fixedpoint.h"
+#include "orderpool.h"
+using namespace std;
+
+// Identifiers at the FIX boundary. Clients name orders with ClOrdID(11), any
+// text they like; the engine only ever sees its own dense order IDs, assigned
+// in sequence as orders arrive. Each session maps its live ClOrdIDs onto them
+// with a clordidtable, and engine IDs and sequence numbers go back out as
+// decimal text written by formatid.
+
+// A ClOrdID held inline: storing, copying or comparing one never touches the
+// heap. Up to maxlength bytes, which is room for a UUID; longer IDs are
+// refused at entry (see fits) rather than truncated.
+class clordid {
+public:
+    static constexpr size_t maxlength = 47;
+
+    clordid() = default;
+    // text must fit.
+    explicit clordid(string_view text) : len_((uint8_t)text.size()) { memcpy(text_, text.data(), text.size()); }
+
+    static bool fits(string_view text) { return !text.empty() && text.size() <= maxlength; }
+
+    string_view view() const { return string_view(text_, len_); }
+    bool empty() const { return len_ == 0; }
+    void clear() { len_ = 0; }
+
+private:
+    char text_[maxlength];
+    uint8_t len_ = 0;
+};
+static_assert(sizeof(clordid) == 48, "clordid layout");
+
+// One session's live ClOrdIDs -> engine order ID. Entries sit in a slab pool,
+// the table's arena, and are reached through a flat open-addressing table of
+// 16-byte {hash, entry} slots, so a lookup is one pass over the text to hash
+// it, usually one slot and one entry compare. Erase backward-shifts like
+// orderindex, and only rehashes if the session outgrows its expected size.
+class clordidtable {
+public:
+    clordidtable() : clordidtable(0) {}
+    explicit clordidtable(size_t expected) : entries_(expected) {
+        size_t capacity = 16;
+        while (capacity < expected * 2) capacity <<= 1;
+        resize(capacity);
+    }
+    clordidtable(const clordidtable&) = delete;
+    clordidtable& operator=(const clordidtable&) = delete;
+
+    // Engine ID for text, or nullptr.
+    const OrderId* find(string_view text) const {
+        uint64_t hash = hashof(text);
+        for (size_t i = home(hash);; i = (i + 1) & mask_) {
+            const slot& s = slots_[i];
+            if (s.entry_ == nullptr) return nullptr;
+            if (s.hash_ == hash && s.entry_->key_.view() == text) return &s.entry_->id_;
+        }
+    }
+
+    // Map text (which must fit a clordid) to id. Returns false, leaving the
+    // table unchanged, if text is already mapped.
+    bool insert(string_view text, OrderId id) {
+        if (size_ + 1 > (mask_ + 1) / 2) resize((mask_ + 1) * 2);
+        uint64_t hash = hashof(text);
+        size_t i = home(hash);
+        for (; slots_[i].entry_ != nullptr; i = (i + 1) & mask_)
+            if (slots_[i].hash_ == hash && slots_[i].entry_->key_.view() == text) return false;
+        slots_[i] = slot{ hash, entries_.acquire(entry{ clordid(text), id }) };
+        ++size_;
+        return true;
+    }
+
+    // Forget text. Returns false if it was not mapped.
+    bool erase(string_view text) {
+        uint64_t hash = hashof(text);
+        size_t i = home(hash);
+        for (;; i = (i + 1) & mask_) {
+            if (slots_[i].entry_ == nullptr) return false;
+            if (slots_[i].hash_ == hash && slots_[i].entry_->key_.view() == text) break;
+        }
+        entries_.release(slots_[i].entry_);
+        for (size_t j = (i + 1) & mask_; slots_[j].entry_ != nullptr; j = (j + 1) & mask_) {
+            size_t h = home(slots_[j].hash_);
+            if (((j - h) & mask_) >= ((j - i) & mask_)) {
+                slots_[i] = slots_[j];
+                i = j;
+            }
+        }
+        slots_[i] = slot{};
+        --size_;
+        return true;
+    }
+
+    size_t size() const { return size_; }
+
+private:
+    struct entry {
+        clordid key_;
+        OrderId id_;
+    };
+    struct slot {
+        uint64_t hash_ = 0;
+        entry* entry_ = nullptr; // nullptr marks an empty slot.
+    };
+
+    // FNV-1a; the Fibonacci step in home() spreads its low-entropy high bits.
+    static uint64_t hashof(string_view text) {
+        uint64_t hash = 14695981039346656037ull;
+        for (char c : text) hash = (hash ^ (uint8_t)c) * 1099511628211ull;
+        return hash;
+    }
+    size_t home(uint64_t hash) const { return (size_t)((hash * 0x9E3779B97F4A7C15ull) >> shift_); }
+
+    void resize(size_t capacity) {
+        vector<slot> old = move(slots_);
+        slots_.assign(capacity, slot{});
+        mask_ = capacity - 1;
+        shift_ = 64 - __builtin_ctzll(capacity);
+        for (const slot& s : old) {
+            if (s.entry_ == nullptr) continue;
+            size_t i = home(s.hash_);
+            while (slots_[i].entry_ != nullptr) i = (i + 1) & mask_;
+            slots_[i] = s;
+        }
+    }
+
+    objectpool<entry, 256> entries_;
+    vector<slot> slots_;
+    size_t mask_ = 0;
+    int shift_ = 64;
+    size_t size_ = 0;
+};
+
+// Decimal text of v into out, which needs room for 20 characters; no
+// terminator is written. Returns the length. Digits are produced two at a
+// time from a pair table, back to front into a local buffer.
+inline size_t formatid(char* out, uint64_t v) {
+    static constexpr char pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    char buf[20];
+    char* p = buf + sizeof(buf);
+    while (v >= 100) {
+        size_t pair = (size_t)(v % 100) * 2;
+        v /= 100;
+        *--p = pairs[pair + 1];
+        *--p = pairs[pair];
+    }
+    if (v >= 10) {
+        *--p = pairs[v * 2 + 1];
+        *--p = pairs[v * 2];
+    }
+    else {
+        *--p = (char)('0' + v);
+    }
+    size_t len = (size_t)(buf + sizeof(buf) - p);
+    memcpy(out, p, len);
+    return len;
+}
+
+#endif // FIXIDS_H
@@ -0,0 +1,285 @@
+#ifndef FIXPARSER_H
+#define FIXPARSER_H
+
+#include "ordercommand.h"
+#if defined(__SSE2__) && defined(__x86_64__)
+#include <emmintrin.h>
+#define FIXPARSER_SSE2 1
+#endif
+
+// In-place decoder for FIX tag=value NewOrderSingle (35=D) messages. It works on
+// the raw bytes as received, never copies or allocates: string fields come back
+// as views into the caller's buffer and numbers are decoded straight to
+// integers. Framing (BeginString, BodyLength, CheckSum) is validated.
+
+enum class fixparsestatus : uint8_t {
+    Ok,
+    Incomplete,     // Need more bytes; nothing consumed.
+    BadFraming,     // Not 8=/9= led, trailer not where BodyLength says.
+    BadChecksum,
+    NotNewOrder,    // Valid message of another type.
+    MissingField,
+    BadValue,       // Malformed or out-of-range field value.
+    OffTick,        // Price finer than the engine's price unit.
+};
+
+struct fixneworder {
+    const char* clordid_;
+    uint32_t clordidlen_;
+    const char* symbol_;
+    uint32_t symbollen_;
+    Side side_;
+    ordertype ordertype_; // From OrdType and TimeInForce (see parsenewordersingle).
+    Price price_;
+    Qty quantity_;
+    Price stop_;          // StopPx(99) of a stop order, else Price::none().
+    Qty display_;         // MaxFloor(111) of an iceberg, else 0.
+    size_t length_;       // Bytes the message occupies, trailer included.
+
+    string_view clordid() const { return string_view(clordid_, clordidlen_); }
+    string_view symbol() const { return string_view(symbol_, symbollen_); }
+    // The engine names orders itself; id is the one assigned to this order.
+    ordercommand tocommand(int book, OrderId id) const {
+        ordercommand cmd{ commandtype::New, ordertype_, side_, book, id, price_, quantity_ };
+        cmd.stop_ = stop_;
+        cmd.display_ = display_;
+        return cmd;
+    }
+};
+
+namespace fixdetail {
+
+inline constexpr char soh = '\x01';
+
+// First SOH in [p, end), or end. 16 bytes per compare on SSE2.
+inline const char* findsoh(const char* p, const char* end) {
+#ifdef FIXPARSER_SSE2
+    const __m128i needle = _mm_set1_epi8(soh);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (mask) return p + __builtin_ctz((unsigned)mask);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != soh) ++p;
+    return p;
+}
+
+// Sum of the bytes in [p, end), for the CheckSum field.
+inline uint32_t bytesum(const char* p, const char* end) {
+    uint64_t sum = 0;
+#ifdef FIXPARSER_SSE2
+    __m128i acc = _mm_setzero_si128();
+    const __m128i zero = _mm_setzero_si128();
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(chunk, zero));
+        p += 16;
+    }
+    sum = (uint64_t)_mm_cvtsi128_si64(acc) + (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc));
+#endif
+    while (p < end) sum += (uint8_t)*p++;
+    return (uint32_t)sum;
+}
+
+// Unsigned decimal in [p, end) with no sign or padding, at most 18 digits.
+inline bool parseuint(const char* p, const char* end, int64_t& out) {
+    if (p == end || end - p > 18) return false;
+    int64_t v = 0;
+    for (; p < end; ++p) {
+        unsigned d = (unsigned)(*p - '0');
+        if (d > 9) return false;
+        v = v * 10 + d;
+    }
+    out = v;
+    return true;
+}
+
+// Fixed-point decimal to engine price units. Digits past Price::decimals are
+// fine if they are zeros. Tick size is the instrument's business and is
+// checked at submission.
+inline fixparsestatus parseprice(const char* p, const char* end, Price& out) {
+    bool negative = p < end && *p == '-';
+    if (negative) ++p;
+    const char* dot = p;
+    while (dot < end && *dot != '.') ++dot;
+    int64_t scaled = 0;
+    if (dot - p > 18 - Price::decimals || !parseuint(p, dot, scaled)) return fixparsestatus::BadValue;
+    const char* f = dot < end ? dot + 1 : end;
+    if (dot < end && f == end) return fixparsestatus::BadValue;
+    for (int i = 0; i < Price::decimals; ++i) {
+        unsigned d = 0;
+        if (f < end) {
+            d = (unsigned)(*f++ - '0');
+            if (d > 9) return fixparsestatus::BadValue;
+        }
+        scaled = scaled * 10 + d;
+    }
+    for (; f < end; ++f) {
+        if (*f == '0') continue;
+        return (unsigned)(*f - '0') <= 9 ? fixparsestatus::OffTick : fixparsestatus::BadValue;
+    }
+    out = Price(negative ? -scaled : scaled);
+    return fixparsestatus::Ok;
+}
+
+// Positive whole quantity; a zero fraction ("100.00") is accepted.
+inline bool parsequantity(const char* p, const char* end, Qty& out) {
+    const char* dot = p;
+    while (dot < end && *dot != '.') ++dot;
+    for (const char* f = dot + (dot < end); f < end; ++f)
+        if (*f != '0') return false;
+    int64_t v;
+    if (!parseuint(p, dot, v) || v <= 0) return false;
+    out = Qty(v);
+    return true;
+}
+
+} // namespace fixdetail
+
+// Decode one NewOrderSingle from the start of [data, data + len). Required
+// fields: ClOrdID(11, any text), Symbol(55), Side(54, 1 or 2), OrderQty(38), Price(44)
+// unless OrdType(40) is 1 (market) or 3 (stop), and StopPx(99) if it is 3 or
+// 4 (stop limit). OrdType defaults to limit; a limit with TimeInForce(59)=3
+// (IOC) maps to fillandkill and 59=4 (FOK) to fillorkill. MaxFloor(111) makes
+// a limit or stop limit an iceberg. Unknown tags are skipped. On BadValue,
+// OffTick and MissingField the fields needed to reject the order (ClOrdID,
+// Symbol, Side) are filled in as far as the message has them: empty if
+// absent, Buy if there is no valid side.
+inline fixparsestatus parsenewordersingle(const char* data, size_t len, fixneworder& out) {
+    using namespace fixdetail;
+    const char* end = data + len;
+
+    // 8=BeginString
+    if (len < 2) return fixparsestatus::Incomplete;
+    if (data[0] != '8' || data[1] != '=') return fixparsestatus::BadFraming;
+    const char* p = findsoh(data + 2, end);
+    if (p == end) return fixparsestatus::Incomplete;
+
+    // 9=BodyLength, counted from the byte after its SOH up to the SOH before 10=.
+    ++p;
+    if (end - p < 2) return fixparsestatus::Incomplete;
+    if (p[0] != '9' || p[1] != '=') return fixparsestatus::BadFraming;
+    const char* value = p + 2;
+    p = findsoh(value, end);
+    if (p == end) return fixparsestatus::Incomplete;
+    int64_t bodylength;
+    if (!parseuint(value, p, bodylength) || bodylength > (1 << 20)) return fixparsestatus::BadFraming;
+    const char* body = p + 1;
+    const char* trailer = body + bodylength;
+    if (end - body < bodylength + 7) return fixparsestatus::Incomplete;
+
+    // 10=NNN<SOH>
+    if (trailer[0] != '1' || trailer[1] != '0' || trailer[2] != '=' || trailer[6] != soh)
+        return fixparsestatus::BadFraming;
+    int64_t checksum;
+    if (!parseuint(trailer + 3, trailer + 6, checksum)) return fixparsestatus::BadFraming;
+    if ((int64_t)(bytesum(data, trailer) & 0xff) != checksum) return fixparsestatus::BadChecksum;
+    out.length_ = (size_t)(trailer + 7 - data);
+
+    // 35=MsgType must lead the body.
+    if (trailer - body < 4 || body[0] != '3' || body[1] != '5' || body[2] != '=')
+        return fixparsestatus::BadFraming;
+    p = findsoh(body + 3, trailer);
+    if (p - body != 4 || body[3] != 'D') return fixparsestatus::NotNewOrder;
+
+    enum : unsigned { hasclordid = 1, hassymbol = 2, hasside = 4, hasqty = 8, hasprice = 16, hasstop = 32 };
+    unsigned seen = 0;
+    char ordtype = '2', timeinforce = '0';
+    out.clordid_ = out.symbol_ = body;
+    out.clordidlen_ = out.symbollen_ = 0;
+    out.side_ = Side::Buy;
+    out.stop_ = Price::none();
+    out.display_ = Qty(0);
+    // A bad value does not stop the scan, so an order with one still has its
+    // ClOrdID, symbol and side decoded for the reject. The first is reported.
+    fixparsestatus invalid = fixparsestatus::Ok;
+    auto fail = [&](fixparsestatus st) {
+        if (invalid == fixparsestatus::Ok) invalid = st;
+    };
+    for (++p; p < trailer; ++p) {
+        unsigned tag = 0;
+        while (p < trailer && *p != '=') {
+            unsigned d = (unsigned)(*p++ - '0');
+            if (d > 9 || tag > 99999) return fixparsestatus::BadFraming;
+            tag = tag * 10 + d;
+        }
+        if (p == trailer) return fixparsestatus::BadFraming;
+        value = p + 1;
+        p = findsoh(value, trailer);
+        if (p == trailer) return fixparsestatus::BadFraming;
+        switch (tag) {
+        case 11:
+            if (p == value) {
+                fail(fixparsestatus::BadValue);
+                break;
+            }
+            out.clordid_ = value;
+            out.clordidlen_ = (uint32_t)(p - value);
+            seen |= hasclordid;
+            break;
+        case 55:
+            if (p == value) {
+                fail(fixparsestatus::BadValue);
+                break;
+            }
+            out.symbol_ = value;
+            out.symbollen_ = (uint32_t)(p - value);
+            seen |= hassymbol;
+            break;
+        case 54:
+            if (p - value != 1 || (*value != '1' && *value != '2')) {
+                fail(fixparsestatus::BadValue);
+                break;
+            }
+            out.side_ = *value == '1' ? Side::Buy : Side::Sell;
+            seen |= hasside;
+            break;
+        case 38:
+            if (parsequantity(value, p, out.quantity_)) seen |= hasqty;
+            else fail(fixparsestatus::BadValue);
+            break;
+        case 44: {
+            fixparsestatus st = parseprice(value, p, out.price_);
+            if (st == fixparsestatus::Ok) seen |= hasprice;
+            else fail(st);
+            break;
+        }
+        case 40:
+            if (p - value != 1 || *value < '1' || *value > '4') fail(fixparsestatus::BadValue);
+            else ordtype = *value;
+            break;
+        case 99: {
+            fixparsestatus st = parseprice(value, p, out.stop_);
+            if (st == fixparsestatus::Ok) seen |= hasstop;
+            else fail(st);
+            break;
+        }
+        case 111:
+            if (!parsequantity(value, p, out.display_)) fail(fixparsestatus::BadValue);
+            break;
+        case 59:
+            if (p - value == 1) timeinforce = *value;
+            break;
+        default:
+            break;
+        }
+    }
+    unsigned required = hasclordid | hassymbol | hasside | hasqty | hasprice;
+    if (ordtype == '1' || ordtype == '3') {
+        out.ordertype_ = ordtype == '1' ? ordertype::Market : ordertype::Stop;
+        out.price_ = Price::none();
+        seen |= hasprice;
+    }
+    else if (ordtype == '4') out.ordertype_ = ordertype::StopLimit;
+    else if (timeinforce == '3') out.ordertype_ = ordertype::fillandkill;
+    else if (timeinforce == '4') out.ordertype_ = ordertype::fillorkill;
+    else out.ordertype_ = ordertype::Limit;
+    if (ordtype == '3' || ordtype == '4') required |= hasstop;
+    if (invalid != fixparsestatus::Ok) return invalid;
+    if ((seen & required) != required) return fixparsestatus::MissingField;
+    return fixparsestatus::Ok;
+}
+
+#endif // FIXPARSER_H
@@ -0,0 +1,237 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "ordercommand.h"
+#include "spscqueue.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// On-disk journal of applied commands: a fixed header followed by fixed-width
+// little-endian records, one per command, in the order the shard applied them.
+// Each record carries a digest of the fills the command produced so a replay
+// can prove it reproduced the same trades.
+struct journalheader {
+    char magic_[4];       // "OBJ1"
+    uint32_t version_;
+    uint32_t recordsize_;
+    uint32_t reserved_;
+};
+
+struct journalrecord {
+    uint64_t timestamp_;  // Steady-clock ns when the command was applied.
+    uint8_t type_;        // commandtype
+    uint8_t ordertype_;
+    uint8_t side_;
+    uint8_t fills_;       // Fill events produced (saturates at 255).
+    int32_t book_;
+    uint64_t id_;
+    int64_t price_;       // Engine price units.
+    int64_t quantity_;
+    uint32_t digest_;     // FNV-1a over the fill events.
+    uint32_t owner_;      // Self-trade prevention owner.
+    int64_t stop_;        // Stop price, or Price::none().
+    int64_t display_;     // Iceberg display quantity.
+};
+static_assert(sizeof(journalheader) == 16, "journal header layout");
+static_assert(sizeof(journalrecord) == 64, "journal record layout");
+
+inline constexpr uint32_t journalversion = 3;
+
+// Folds the Fill events of one command into a count and a digest.
+struct filldigest {
+    uint32_t hash_ = 2166136261u;
+    uint32_t fills_ = 0;
+
+    void add(const execevent& ev) {
+        if (ev.type_ != eventtype::Fill) return;
+        ++fills_;
+        mix((uint32_t)ev.side_);
+        mix64(ev.id_.value());
+        mix64((uint64_t)ev.price_.value());
+        mix64((uint64_t)ev.quantity_.value());
+    }
+private:
+    void mix64(uint64_t v) {
+        mix((uint32_t)v);
+        mix((uint32_t)(v >> 32));
+    }
+    void mix(uint32_t v) {
+        for (int i = 0; i < 4; ++i) {
+            hash_ ^= (v >> (8 * i)) & 0xff;
+            hash_ *= 16777619u;
+        }
+    }
+};
+
+inline journalrecord makerecord(const ordercommand& cmd, const filldigest& digest, uint64_t timestamp) {
+    return journalrecord{ timestamp, (uint8_t)cmd.type_, (uint8_t)cmd.ordertype_, (uint8_t)cmd.side_,
+        (uint8_t)min<uint32_t>(digest.fills_, 255), cmd.book_, cmd.id_.value(), cmd.price_.value(), cmd.quantity_.value(),
+        digest.hash_, cmd.owner_, cmd.stop_.value(), cmd.display_.value() };
+}
+
+inline ordercommand tocommand(const journalrecord& rec) {
+    return ordercommand{ (commandtype)rec.type_, (ordertype)rec.ordertype_, (Side)rec.side_,
+        rec.book_, OrderId(rec.id_), Price(rec.price_), Qty(rec.quantity_), rec.owner_, 0,
+        Price(rec.stop_), Qty(rec.display_) };
+}
+
+// Overwrite starts a fresh journal for offline replay. Durable appends to an
+// existing journal (a write-ahead log that outlives the process) and group
+// commits: every batch the writer drains is fdatasync'ed before committed()
+// moves past it, so records arriving during one sync share the next.
+enum class journalmode { Overwrite, Durable };
+
+// Append-only journal writer. The recording thread only pushes a 64-byte
+// record into an SPSC ring; a background thread batches records into a large
+// buffer and writes it out, so file I/O never runs on the matching thread.
+class journalwriter {
+public:
+    explicit journalwriter(const string& path, journalmode mode = journalmode::Overwrite,
+        size_t ringcapacity = 1 << 16, size_t buffersize = 1 << 20)
+        : ring_(ringcapacity), buffer_(buffersize), durable_(mode == journalmode::Durable) {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | (durable_ ? 0 : O_TRUNC), 0644);
+        if (fd_ < 0)
+            throw runtime_error("journalwriter: cannot open " + path);
+        if (!reopen()) {
+            ::close(fd_);
+            throw runtime_error("journalwriter: not a version " + to_string(journalversion) + " journal: " + path);
+        }
+        flusher_ = thread([this] { run(); });
+    }
+    ~journalwriter() {
+        running_ = false;
+        flusher_.join();
+        ::close(fd_);
+    }
+    journalwriter(const journalwriter&) = delete;
+    journalwriter& operator=(const journalwriter&) = delete;
+
+    // Recording thread only. Waits for room rather than losing a record.
+    void append(const journalrecord& rec) {
+        if (ring_.push(rec)) return;
+        stalls_.fetch_add(1, memory_order_relaxed);
+        while (!ring_.push(rec)) cpurelax();
+    }
+
+    uint64_t stalls() const { return stalls_.load(memory_order_relaxed); }
+    // Records in the file (including those from earlier runs) that are written
+    // and, for a durable journal, synced.
+    uint64_t committed() const { return committed_.load(memory_order_acquire); }
+
+private:
+    // Write the header into an empty file, or validate an existing one and cut
+    // off a torn trailing record so appends stay aligned.
+    bool reopen() {
+        struct stat st;
+        if (::fstat(fd_, &st) != 0) return false;
+        if (st.st_size == 0) {
+            journalheader header{ { 'O', 'B', 'J', '1' }, journalversion, sizeof(journalrecord), 0 };
+            writeall(&header, sizeof(header));
+            return true;
+        }
+        journalheader header;
+        if ((size_t)st.st_size < sizeof(header) || ::pread(fd_, &header, sizeof(header), 0) != (ssize_t)sizeof(header)
+            || memcmp(header.magic_, "OBJ1", 4) != 0 || header.version_ != journalversion
+            || header.recordsize_ != sizeof(journalrecord))
+            return false;
+        uint64_t records = ((size_t)st.st_size - sizeof(header)) / sizeof(journalrecord);
+        off_t end = (off_t)(sizeof(header) + records * sizeof(journalrecord));
+        if (::ftruncate(fd_, end) != 0 || ::lseek(fd_, end, SEEK_SET) != end) return false;
+        committed_.store(records, memory_order_release);
+        return true;
+    }
+
+    void run() {
+        journalrecord rec;
+        size_t used = 0;
+        const size_t capacity = buffer_.size() / sizeof(journalrecord) * sizeof(journalrecord);
+        while (true) {
+            bool got = false;
+            while (used < capacity && ring_.pop(rec)) {
+                memcpy(buffer_.data() + used, &rec, sizeof(rec));
+                used += sizeof(rec);
+                got = true;
+            }
+            // Write when the buffer is full or the ring has gone quiet; a
+            // durable journal commits every drained batch.
+            if (used == capacity || (used > 0 && (!got || durable_))) {
+                writeall(buffer_.data(), used);
+                if (durable_ && ::fdatasync(fd_) != 0)
+                    throw runtime_error("journalwriter: fdatasync failed");
+                committed_.fetch_add(used / sizeof(journalrecord), memory_order_release);
+                used = 0;
+            }
+            if (!got) {
+                if (!running_.load(memory_order_acquire) && ring_.size() == 0) break;
+                this_thread::sleep_for(chrono::microseconds(100));
+            }
+        }
+    }
+
+    void writeall(const void* data, size_t size) {
+        const char* p = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t n = ::write(fd_, p, size);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw runtime_error("journalwriter: write failed");
+            }
+            p += n;
+            size -= (size_t)n;
+        }
+    }
+
+    spscqueue<journalrecord> ring_;
+    vector<char> buffer_;
+    bool durable_;
+    int fd_ = -1;
+    atomic<bool> running_{ true };
+    atomic<uint64_t> stalls_{ 0 };
+    atomic<uint64_t> committed_{ 0 };
+    thread flusher_;
+};
+
+// Read-only memory-mapped view of a journal file.
+class journalreader {
+public:
+    explicit journalreader(const string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw runtime_error("journalreader: cannot open " + path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(journalheader)) {
+            ::close(fd);
+            throw runtime_error("journalreader: truncated journal " + path);
+        }
+        size_ = (size_t)st.st_size;
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+            throw runtime_error("journalreader: mmap failed for " + path);
+        data_ = static_cast<const char*>(p);
+        const journalheader* header = reinterpret_cast<const journalheader*>(data_);
+        if (memcmp(header->magic_, "OBJ1", 4) != 0 || header->version_ != journalversion
+            || header->recordsize_ != sizeof(journalrecord)) {
+            ::munmap(const_cast<char*>(data_), size_);
+            throw runtime_error("journalreader: not a version " + to_string(journalversion) + " journal: " + path);
+        }
+    }
+    ~journalreader() { ::munmap(const_cast<char*>(data_), size_); }
+    journalreader(const journalreader&) = delete;
+    journalreader& operator=(const journalreader&) = delete;
+
+    // A torn trailing record (crash mid-write) is ignored.
+    size_t size() const { return (size_ - sizeof(journalheader)) / sizeof(journalrecord); }
+    const journalrecord* begin() const {
+        return reinterpret_cast<const journalrecord*>(data_ + sizeof(journalheader));
+    }
+    const journalrecord* end() const { return begin() + size(); }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+#endif // JOURNAL_H
@@ -0,0 +1,162 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include "spscqueue.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Hot-path instrumentation: a cheap timestamp source and a fixed-size latency
+// histogram that one thread can record into without locks, read-modify-write
+// atomics or allocation.
+
+// Timestamps in clock ticks: the TSC on x86 (constant-rate and synchronised
+// across cores on the CPUs this runs on, so stamps from different threads
+// compare), steady_clock nanoseconds elsewhere. Subtract two stamps and pass
+// the difference to tons().
+struct latencyclock {
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    static uint64_t tons(uint64_t ticks) { return (uint64_t)((double)ticks * nspertick()); }
+
+    // Measured against steady_clock on first use (about 10ms); call it at
+    // startup so no hot-path caller pays for that.
+    static double nspertick() {
+        static const double rate = calibrate();
+        return rate;
+    }
+
+private:
+    static double calibrate() {
+#if defined(__x86_64__) || defined(__i386__)
+        auto start = chrono::steady_clock::now();
+        uint64_t ticks = __rdtsc();
+        while (chrono::steady_clock::now() - start < chrono::milliseconds(10)) {}
+        uint64_t elapsed = __rdtsc() - ticks;
+        double ns = (double)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        return elapsed ? ns / (double)elapsed : 1.0;
+#else
+        return 1.0;
+#endif
+    }
+};
+
+// Counter owned by one writer thread: a relaxed load and store instead of a
+// locked add. Other threads may read it at any time.
+inline void bump(atomic<uint64_t>& counter, uint64_t n = 1) {
+    counter.store(counter.load(memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+struct latencysummary {
+    uint64_t count = 0;
+    uint64_t mean = 0;
+    uint64_t p50 = 0;
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+};
+
+// Log-linear (HDR-style) histogram: values below 2^subbits are exact, larger
+// ones land in one of 2^subbits sub-buckets per power of two, so a reported
+// percentile is at most ~3% above the true value. Values of 2^maxbits and up
+// (about 18 minutes in ns) share the last bucket. Recording is single-writer;
+// snapshots taken from another thread may be a few records behind.
+class latencyhistogram {
+public:
+    static constexpr int subbits = 5;
+    static constexpr int maxbits = 40;
+    static constexpr size_t bucketcount = (size_t)(maxbits - subbits + 1) << subbits;
+
+    void record(uint64_t value) {
+        bump(counts_[bucketof(value)]);
+        bump(count_);
+        bump(sum_, value);
+        if (value > max_.load(memory_order_relaxed)) max_.store(value, memory_order_relaxed);
+    }
+
+    uint64_t count() const { return count_.load(memory_order_relaxed); }
+
+    // Plain copy of the counts, for percentiles and for merging histograms
+    // recorded by different threads.
+    struct snapshot {
+        vector<uint64_t> counts_ = vector<uint64_t>(bucketcount);
+        uint64_t count_ = 0;
+        uint64_t sum_ = 0;
+        uint64_t max_ = 0;
+
+        void merge(const snapshot& other) {
+            for (size_t i = 0; i < bucketcount; ++i) counts_[i] += other.counts_[i];
+            count_ += other.count_;
+            sum_ += other.sum_;
+            max_ = std::max(max_, other.max_);
+        }
+
+        // Upper bound of the bucket holding the p-th percentile (0 < p <= 100).
+        uint64_t percentile(double p) const {
+            if (count_ == 0) return 0;
+            uint64_t rank = std::max<uint64_t>(1, (uint64_t)ceil(p / 100.0 * (double)count_));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < bucketcount; ++i) {
+                seen += counts_[i];
+                if (seen >= rank) return std::min(upperbound(i), max_);
+            }
+            return max_;
+        }
+
+        latencysummary summary() const {
+            return latencysummary{ count_, count_ ? sum_ / count_ : 0, percentile(50), percentile(90),
+                percentile(99), percentile(99.9), max_ };
+        }
+    };
+
+    snapshot take() const {
+        snapshot s;
+        for (size_t i = 0; i < bucketcount; ++i) s.counts_[i] = counts_[i].load(memory_order_relaxed);
+        // Derive the count from the buckets so percentiles stay consistent
+        // with a writer that is mid-record.
+        s.count_ = accumulate(s.counts_.begin(), s.counts_.end(), uint64_t(0));
+        s.sum_ = sum_.load(memory_order_relaxed);
+        s.max_ = max_.load(memory_order_relaxed);
+        return s;
+    }
+
+    latencysummary summary() const { return take().summary(); }
+
+    static size_t bucketof(uint64_t value) {
+        if (value < (1u << subbits)) return (size_t)value;
+        int msb = 63 - __builtin_clzll(value);
+        if (msb >= maxbits) return bucketcount - 1;
+        int shift = msb - subbits;
+        return ((size_t)(shift + 1) << subbits) + (size_t)((value >> shift) & ((1u << subbits) - 1));
+    }
+
+    static uint64_t upperbound(size_t bucket) {
+        if (bucket < (1u << subbits)) return bucket;
+        int shift = (int)(bucket >> subbits) - 1;
+        uint64_t lower = (uint64_t)((1u << subbits) + (bucket & ((1u << subbits) - 1))) << shift;
+        return lower + (uint64_t(1) << shift) - 1;
+    }
+
+private:
+    array<atomic<uint64_t>, bucketcount> counts_{};
+    atomic<uint64_t> count_{ 0 };
+    atomic<uint64_t> sum_{ 0 };
+    atomic<uint64_t> max_{ 0 };
+};
+
+// One line per histogram: "name: n=.. mean=.. p50=.. p90=.. p99=.. p99.9=.. max=..unit".
+inline void writesummary(ostream& os, const string& name, const latencysummary& s, const char* unit = "ns") {
+    os << name << ": n=" << s.count << " mean=" << s.mean << unit << " p50=" << s.p50 << unit
+       << " p90=" << s.p90 << unit << " p99=" << s.p99 << unit << " p99.9=" << s.p999 << unit
+       << " max=" << s.max << unit << '\n';
+}
+
+#endif // LATENCY_H
@@ -1,23 +1,114 @@
-#include "Orderbook.h"
-#include "FixApp.h"
+#include "orderbookmanager.h"
+#include "fixapp.h"
 #include "quickfix/SessionSettings.h"
 #include "quickfix/FileStore.h"
 #include "quickfix/FileLog.h"
 #include "quickfix/SocketInitiator.h"
 #include <iostream>
+#include <sstream>
 #include <thread>
 #include <chrono>
 
+// Split a comma-separated setting such as "AAPL,MSFT".
+static std::vector<std::string> splitlist(const std::string& value) {
+    std::vector<std::string> items;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty()) items.push_back(item);
+    return items;
+}
+
+// SelfTradePrevention setting: None, CancelNewest, CancelOldest, CancelBoth or Decrement.
+static stpmode parseStpMode(const std::string& value) {
+    static const std::map<std::string, stpmode> modes{ { "None", stpmode::None },
+        { "CancelNewest", stpmode::CancelNewest }, { "CancelOldest", stpmode::CancelOldest },
+        { "CancelBoth", stpmode::CancelBoth }, { "Decrement", stpmode::Decrement } };
+    auto it = modes.find(value);
+    if (it == modes.end()) throw std::invalid_argument("Unknown SelfTradePrevention mode: " + value);
+    return it->second;
+}
+
+// Pre-trade risk limits from a session's settings; missing keys leave that
+// check disabled. Notional limits are in currency, converted to price units.
+static risklimits readRiskLimits(const FIX::Dictionary& d) {
+    risklimits limits;
+    auto notional = [&](const char* key) { return (int64_t)std::llround(d.getDouble(key) * Price::scale); };
+    if (d.has("RiskMaxOrderQty")) limits.maxorderqty = Qty(d.getInt("RiskMaxOrderQty"));
+    if (d.has("RiskMaxNotional")) limits.maxnotional = notional("RiskMaxNotional");
+    if (d.has("RiskPriceBandBps")) limits.pricebandbps = d.getInt("RiskPriceBandBps");
+    if (d.has("RiskMaxOpenOrders")) limits.maxopenorders = d.getInt("RiskMaxOpenOrders");
+    if (d.has("RiskMaxPosition")) limits.maxposition = Qty(d.getInt("RiskMaxPosition"));
+    if (d.has("RiskMaxExposure")) limits.maxexposure = notional("RiskMaxExposure");
+    if (d.has("RiskMaxMessagesPerSecond")) limits.maxmessagespersecond = d.getInt("RiskMaxMessagesPerSecond");
+    if (d.has("RiskBurst")) limits.burst = std::max(1, d.getInt("RiskBurst"));
+    return limits;
+}
+
 int main(int argc, char** argv) {
     try {
         // Load QuickFIX configuration.
         FIX::SessionSettings settings("trading_confi.cfg");
+        const FIX::Dictionary& defaults = settings.get();
+
+        // Matching layout: one book per symbol, spread over MatchingThreads
+        // shards, optionally pinned to MatchingCpus. A symbol may carry its
+        // tick and lot size as SYMBOL:tick:lot, e.g. AAPL:0.01:100.
+        std::vector<std::string> symbols{ "STOCK" };
+        if (defaults.has("Symbols"))
+            symbols = splitlist(defaults.getString("Symbols"));
+        size_t threads = defaults.has("MatchingThreads") ? defaults.getInt("MatchingThreads") : 1;
+        std::vector<int> cpus;
+        if (defaults.has("MatchingCpus"))
+            for (const auto& cpu : splitlist(defaults.getString("MatchingCpus")))
+                cpus.push_back(std::stoi(cpu));
+
+        // Peak resting orders per book; the order pool and ID index are sized for
+        // it up front so they never grow mid-session.
+        size_t expectedOrders = defaults.has("ExpectedOrders") ? (size_t)defaults.getInt("ExpectedOrders") : 0;
+
+        // Self-trade prevention between orders of the same session, off
+        // (None) unless SelfTradePrevention names a mode.
+        stpmode stp = defaults.has("SelfTradePrevention") ? parseStpMode(defaults.getString("SelfTradePrevention")) : stpmode::None;
 
         // Instantiate the order matching engine.
-        Orderbook orderbook;
+        OrderbookManager books(threads, cpus);
+        for (const auto& entry : symbols) {
+            std::stringstream ss(entry);
+            std::string symbol, tick, lot;
+            std::getline(ss, symbol, ':');
+            std::getline(ss, tick, ':');
+            std::getline(ss, lot, ':');
+            instrumentspec spec;
+            spec.stp = stp;
+            if (!tick.empty()) spec.ticksize = Price::fromdouble(std::stod(tick));
+            if (!lot.empty()) spec.lotsize = Qty(std::stoll(lot));
+            books.addsymbol(symbol, {}, expectedOrders, spec);
+        }
+        // Optional crash recovery: the books are rebuilt from the last snapshot
+        // and write-ahead log under RecoveryPath, which then keeps logging.
+        // Otherwise an optional binary command journal for offline replay.
+        OrderId firstOrderId(1);
+        if (defaults.has("RecoveryPath")) {
+            recoverystats recovered = books.enablerecovery(defaults.getString("RecoveryPath"),
+                defaults.has("BookSnapshotInterval") ? (size_t)defaults.getInt("BookSnapshotInterval") : 1000000);
+            std::cout << "Recovered " << recovered.snapshotorders << " orders from snapshots and "
+                      << recovered.replayed << " WAL records in " << recovered.seconds * 1e3 << " ms" << std::endl;
+            // Engine order IDs carry on past every ID the books have seen.
+            firstOrderId = OrderId(recovered.lastid.value() + 1);
+        }
+        else if (defaults.has("JournalPath"))
+            books.enablejournal(defaults.getString("JournalPath"));
+        if (defaults.has("MarketDataShm"))
+            books.enablemarketdata(defaults.getString("MarketDataShm"),
+                defaults.has("SnapshotInterval") ? (size_t)defaults.getInt("SnapshotInterval") : 10000);
+        books.start();
 
-        // Create our FIX application.
-        FixApp application(orderbook);
+        // Create our FIX application, with each session's risk limits.
+        std::map<FIX::SessionID, risklimits> limits;
+        for (const FIX::SessionID& session : settings.getSessions())
+            limits.emplace(session, readRiskLimits(settings.get(session)));
+        FixApp application(books, std::move(limits), readRiskLimits(defaults), firstOrderId);
 
         // Set up store and log factories.
         FIX::FileStoreFactory storeFactory(settings);
@@ -29,22 +120,44 @@ int main(int argc, char** argv) {
 
         std::cout << "FIX Engine started. Waiting for orders..." << std::endl;
 
-        // For demonstration, run for 60 seconds to receive orders.
-        std::this_thread::sleep_for(std::chrono::seconds(60));
-
-        // Optionally, print the aggregated order book.
-        AggregatedOrderbook aggbook = orderbook.getorderinfo();
-        std::cout << "\n--- Aggregated Order Book ---" << std::endl;
-        std::cout << "Bids:" << std::endl;
-        for (const auto& bid : aggbook.getbids()) {
-            std::cout << "Price: " << bid.price << ", Quantity: " << bid.quantity << std::endl;
-        }
-        std::cout << "Asks:" << std::endl;
-        for (const auto& ask : aggbook.getasks()) {
-            std::cout << "Price: " << ask.price << ", Quantity: " << ask.quantity << std::endl;
+        // For demonstration, run for 60 seconds to receive orders, dumping
+        // counters and latency percentiles every StatsInterval seconds.
+        int statsInterval = defaults.has("StatsInterval") ? defaults.getInt("StatsInterval") : 0;
+        auto end = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+        while (std::chrono::steady_clock::now() < end) {
+            auto wake = statsInterval > 0 ? std::min(end, std::chrono::steady_clock::now() + std::chrono::seconds(statsInterval)) : end;
+            std::this_thread::sleep_until(wake);
+            if (statsInterval > 0) {
+                books.writestats(std::cout);
+                application.writeStats(std::cout);
+                std::cout << std::flush;
+            }
         }
 
         initiator.stop();
+        books.stop();
+
+        // Backpressure seen by each matching shard.
+        for (size_t shard = 0; shard < books.shardcount(); ++shard) {
+            ringstats st = books.ingressstats(shard);
+            std::cout << "Shard " << shard << ": " << st.popped << " commands, " << st.dropped
+                << " dropped, max depth " << st.maxdepth << ", wait avg " << st.avgwaitns
+                << "ns max " << st.maxwaitns << "ns, event stalls " << books.eventstalls(shard) << std::endl;
+        }
+
+        // Optionally, print the aggregated order books.
+        for (size_t book = 0; book < books.bookcount(); ++book) {
+            AggregatedOrderbook aggbook = books.getbook(book).getorderinfo();
+            std::cout << "\n--- Aggregated Order Book: " << books.symbolname(book) << " ---" << std::endl;
+            std::cout << "Bids:" << std::endl;
+            for (const auto& bid : aggbook.getbids()) {
+                std::cout << "Price: " << bid.price << ", Quantity: " << bid.quantity << std::endl;
+            }
+            std::cout << "Asks:" << std::endl;
+            for (const auto& ask : aggbook.getasks()) {
+                std::cout << "Price: " << ask.price << ", Quantity: " << ask.quantity << std::endl;
+            }
+        }
         return 0;
     }
     catch (std::exception& e) {
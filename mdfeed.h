@@ -0,0 +1,221 @@
+#ifndef MDFEED_H
+#define MDFEED_H
+
+#include "orderbook.h"
+#include "spscqueue.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Incremental market data. After every command a shard publishes one Level
+// message per price level the command changed (carrying the level's new total,
+// so a lost message is repaired by the next one for that level) and one Trade
+// message per fill. Every snapshotinterval commands it also publishes a
+// SnapshotBegin/SnapshotLevel.../SnapshotEnd run per book so late joiners and
+// receivers that saw a gap can rebuild without asking anyone.
+enum class mdtype : uint8_t { Level, Trade, SnapshotBegin, SnapshotLevel, SnapshotEnd };
+
+struct mdmessage {
+    uint64_t seq_;        // Per-feed, starts at 1, no gaps.
+    uint8_t type_;        // mdtype
+    uint8_t side_;        // Side of the level; aggressor side for trades.
+    uint16_t reserved_;
+    int32_t book_;
+    int64_t price_;       // Engine price units.
+    int64_t quantity_;    // Level total (0 = level removed) or trade size.
+    int32_t orders_;      // Orders resting at the level.
+    uint32_t reserved2_;
+};
+static_assert(sizeof(mdmessage) == 40, "md message layout");
+
+// Broadcast ring in POSIX shared memory: one writer, any number of readers in
+// other processes, nobody ever blocks the writer. Each slot carries the
+// sequence number it holds; the writer zeroes it before rewriting the slot, so a
+// reader that was lapped sees a different sequence and reports a gap instead of
+// returning a torn message.
+struct mdshmheader {
+    char magic_[8];       // "OBMD2"
+    uint64_t capacity_;   // Slots, power of two.
+    alignas(cachelinesize) uint64_t next_;  // Sequence the writer publishes next.
+};
+
+class mdshmwriter {
+public:
+    mdshmwriter(const string& name, size_t capacity) : name_(name) {
+        size_t n = 1;
+        while (n < capacity) n <<= 1;
+        mask_ = n - 1;
+        bytes_ = sizeof(mdshmheader) + n * sizeof(mdmessage);
+        int fd = ::shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+        if (fd < 0)
+            throw runtime_error("mdshmwriter: cannot open " + name);
+        if (::ftruncate(fd, (off_t)bytes_) != 0) {
+            ::close(fd);
+            throw runtime_error("mdshmwriter: cannot size " + name);
+        }
+        void* p = ::mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+            throw runtime_error("mdshmwriter: mmap failed for " + name);
+        header_ = static_cast<mdshmheader*>(p);
+        slots_ = reinterpret_cast<mdmessage*>(header_ + 1);
+        memset(p, 0, bytes_);
+        memcpy(header_->magic_, "OBMD2", 6);
+        header_->capacity_ = n;
+        __atomic_store_n(&header_->next_, uint64_t(1), __ATOMIC_RELEASE);
+    }
+    ~mdshmwriter() {
+        ::munmap(header_, bytes_);
+        ::shm_unlink(name_.c_str());
+    }
+    mdshmwriter(const mdshmwriter&) = delete;
+    mdshmwriter& operator=(const mdshmwriter&) = delete;
+
+    void write(const mdmessage& msg) {
+        mdmessage& slot = slots_[msg.seq_ & mask_];
+        __atomic_store_n(&slot.seq_, uint64_t(0), __ATOMIC_RELAXED);
+        atomic_thread_fence(memory_order_release);
+        memcpy(reinterpret_cast<char*>(&slot) + sizeof(slot.seq_),
+            reinterpret_cast<const char*>(&msg) + sizeof(msg.seq_), sizeof(msg) - sizeof(msg.seq_));
+        __atomic_store_n(&slot.seq_, msg.seq_, __ATOMIC_RELEASE);
+        __atomic_store_n(&header_->next_, msg.seq_ + 1, __ATOMIC_RELEASE);
+    }
+
+private:
+    string name_;
+    mdshmheader* header_ = nullptr;
+    mdmessage* slots_ = nullptr;
+    size_t mask_ = 0;
+    size_t bytes_ = 0;
+};
+
+class mdshmreader {
+public:
+    enum class status { Message, Empty, Gap };
+
+    explicit mdshmreader(const string& name) {
+        int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+            throw runtime_error("mdshmreader: cannot open " + name);
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(mdshmheader)) {
+            ::close(fd);
+            throw runtime_error("mdshmreader: feed not initialised: " + name);
+        }
+        bytes_ = (size_t)st.st_size;
+        void* p = ::mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+            throw runtime_error("mdshmreader: mmap failed for " + name);
+        header_ = static_cast<const mdshmheader*>(p);
+        if (memcmp(header_->magic_, "OBMD2", 6) != 0
+            || bytes_ != sizeof(mdshmheader) + header_->capacity_ * sizeof(mdmessage)) {
+            ::munmap(const_cast<mdshmheader*>(header_), bytes_);
+            throw runtime_error("mdshmreader: not an OBMD2 feed: " + name);
+        }
+        slots_ = reinterpret_cast<const mdmessage*>(header_ + 1);
+        mask_ = header_->capacity_ - 1;
+        // Start from the live edge; wait for the next snapshot to build state.
+        expected_ = __atomic_load_n(&header_->next_, __ATOMIC_ACQUIRE);
+    }
+    ~mdshmreader() { ::munmap(const_cast<mdshmheader*>(header_), bytes_); }
+    mdshmreader(const mdshmreader&) = delete;
+    mdshmreader& operator=(const mdshmreader&) = delete;
+
+    // Message: out holds the next message in sequence. Gap: the writer lapped
+    // this reader; it has been moved to the live edge and must resync from the
+    // next snapshot.
+    status poll(mdmessage& out) {
+        uint64_t next = __atomic_load_n(&header_->next_, __ATOMIC_ACQUIRE);
+        if (next <= expected_) return status::Empty;
+        if (next - expected_ <= mask_ + 1) {
+            const mdmessage& slot = slots_[expected_ & mask_];
+            if (__atomic_load_n(&slot.seq_, __ATOMIC_ACQUIRE) == expected_) {
+                memcpy(&out, &slot, sizeof(out));
+                atomic_thread_fence(memory_order_acquire);
+                if (__atomic_load_n(&slot.seq_, __ATOMIC_RELAXED) == expected_) {
+                    out.seq_ = expected_++;
+                    return status::Message;
+                }
+            }
+        }
+        ++gaps_;
+        expected_ = __atomic_load_n(&header_->next_, __ATOMIC_ACQUIRE);
+        return status::Gap;
+    }
+
+    uint64_t gaps() const { return gaps_; }
+
+private:
+    const mdshmheader* header_ = nullptr;
+    const mdmessage* slots_ = nullptr;
+    size_t mask_ = 0;
+    size_t bytes_ = 0;
+    uint64_t expected_ = 0;
+    uint64_t gaps_ = 0;
+};
+
+// Per-shard publisher, driven by the shard thread only. Messages go to
+// in-process subscribers (called inline, so they must be quick) and, if
+// configured, to a shared-memory feed.
+class mdpublisher {
+public:
+    using subscriber = function<void(const mdmessage&)>;
+
+    explicit mdpublisher(size_t snapshotinterval = 0, size_t snapshotdepth = 16)
+        : snapshotinterval_(snapshotinterval), depth_(snapshotdepth) {
+    }
+
+    void attachshm(const string& name, size_t capacity = 1 << 16) {
+        shm_ = make_unique<mdshmwriter>(name, capacity);
+    }
+    void subscribe(subscriber f) { subscribers_.push_back(move(f)); }
+
+    void trade(int book, Side aggressor, Price price, Qty quantity) {
+        publish(mdtype::Trade, aggressor, book, price, quantity, 0);
+    }
+
+    // Publish the coalesced level changes left behind by one command.
+    void endcommand(int book, Orderbook& ob) {
+        ob.consumechanges([&](Side side, const Levelinfo& level) {
+            publish(mdtype::Level, side, book, level.price, level.quantity, level.orders);
+            });
+        ++commands_;
+    }
+
+    bool snapshotdue() const {
+        return snapshotinterval_ > 0 && commands_ - lastsnapshot_ >= snapshotinterval_;
+    }
+
+    // Top snapshotdepth levels of each side of one book.
+    void snapshot(int book, const Orderbook& ob) {
+        lastsnapshot_ = commands_;
+        publish(mdtype::SnapshotBegin, Side::Buy, book, Price(0), Qty(0), 0);
+        for (Side side : { Side::Buy, Side::Sell }) {
+            size_t n = ob.getdepth(side, depth_.data(), depth_.size());
+            for (size_t i = 0; i < n; ++i)
+                publish(mdtype::SnapshotLevel, side, book, depth_[i].price, depth_[i].quantity, depth_[i].orders);
+        }
+        publish(mdtype::SnapshotEnd, Side::Buy, book, Price(0), Qty(0), 0);
+    }
+
+    uint64_t published() const { return seq_; }
+
+private:
+    void publish(mdtype type, Side side, int book, Price price, Qty quantity, int orders) {
+        mdmessage msg{ ++seq_, (uint8_t)type, (uint8_t)side, 0, book, price.value(), quantity.value(), orders, 0 };
+        for (auto& f : subscribers_) f(msg);
+        if (shm_) shm_->write(msg);
+    }
+
+    size_t snapshotinterval_;
+    vector<Levelinfo> depth_;
+    vector<subscriber> subscribers_;
+    unique_ptr<mdshmwriter> shm_;
+    uint64_t seq_ = 0;
+    uint64_t commands_ = 0;
+    uint64_t lastsnapshot_ = 0;
+};
+
+#endif // MDFEED_H
@@ -0,0 +1,117 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include "spscqueue.h"
+
+// Snapshot of a ring's backpressure counters.
+struct ringstats {
+    uint64_t pushed = 0;    // Items accepted.
+    uint64_t dropped = 0;   // Pushes refused because the ring was full.
+    uint64_t popped = 0;
+    size_t depth = 0;       // Items queued right now.
+    size_t maxdepth = 0;    // Deepest queue seen by the consumer.
+    uint64_t avgwaitns = 0; // Mean time from push to pop.
+    uint64_t maxwaitns = 0;
+};
+
+inline uint64_t nowns() {
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Bounded lock-free multi-producer/single-consumer ring (per-slot sequence
+// numbers, after Vyukov). Producers claim a slot with one CAS on the tail; the
+// consumer never contends with them. Each slot carries its push timestamp so the
+// consumer can report queueing delay.
+template <class T>
+class mpscqueue {
+    static_assert(is_trivially_copyable_v<T>, "ring slots are copied by value");
+public:
+    explicit mpscqueue(size_t capacity) {
+        size_t n = 1;
+        while (n < capacity) n <<= 1;
+        slots_ = make_unique<slot[]>(n);
+        for (size_t i = 0; i < n; ++i) slots_[i].seq_.store(i, memory_order_relaxed);
+        mask_ = n - 1;
+    }
+    mpscqueue(const mpscqueue&) = delete;
+    mpscqueue& operator=(const mpscqueue&) = delete;
+
+    // Any thread. Returns false (and counts a drop) when the ring is full.
+    bool push(const T& item) {
+        size_t pos = tail_.load(memory_order_relaxed);
+        slot* s;
+        while (true) {
+            s = &slots_[pos & mask_];
+            size_t seq = s->seq_.load(memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) break;
+            }
+            else if (diff < 0) {
+                dropped_.fetch_add(1, memory_order_relaxed);
+                return false;
+            }
+            else {
+                pos = tail_.load(memory_order_relaxed);
+            }
+        }
+        s->item_ = item;
+        s->stamp_ = nowns();
+        s->seq_.store(pos + 1, memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only.
+    bool pop(T& item) {
+        size_t head = head_.load(memory_order_relaxed);
+        slot& s = slots_[head & mask_];
+        if (s.seq_.load(memory_order_acquire) != head + 1) return false;
+        item = s.item_;
+        uint64_t wait = nowns() - s.stamp_;
+        size_t depth = tail_.load(memory_order_relaxed) - head;
+        s.seq_.store(head + mask_ + 1, memory_order_release);
+        head_.store(head + 1, memory_order_release);
+
+        // Consumer-owned counters: single writer, relaxed is enough for readers.
+        waitns_.store(waitns_.load(memory_order_relaxed) + wait, memory_order_relaxed);
+        if (wait > maxwaitns_.load(memory_order_relaxed)) maxwaitns_.store(wait, memory_order_relaxed);
+        if (depth > maxdepth_.load(memory_order_relaxed)) maxdepth_.store(depth, memory_order_relaxed);
+        return true;
+    }
+
+    size_t size() const {
+        return tail_.load(memory_order_acquire) - head_.load(memory_order_acquire);
+    }
+    size_t capacity() const { return mask_ + 1; }
+
+    ringstats stats() const {
+        ringstats st;
+        st.popped = head_.load(memory_order_acquire);
+        st.pushed = max<uint64_t>(tail_.load(memory_order_acquire), st.popped);
+        st.dropped = dropped_.load(memory_order_relaxed);
+        st.depth = st.pushed - st.popped;
+        st.maxdepth = maxdepth_.load(memory_order_relaxed);
+        st.avgwaitns = st.popped ? waitns_.load(memory_order_relaxed) / st.popped : 0;
+        st.maxwaitns = maxwaitns_.load(memory_order_relaxed);
+        return st;
+    }
+
+private:
+    struct slot {
+        atomic<size_t> seq_;
+        uint64_t stamp_;
+        T item_;
+    };
+
+    unique_ptr<slot[]> slots_;
+    size_t mask_ = 0;
+    alignas(cachelinesize) atomic<size_t> tail_{ 0 };
+    atomic<uint64_t> dropped_{ 0 };
+    alignas(cachelinesize) atomic<size_t> head_{ 0 };
+    atomic<uint64_t> waitns_{ 0 };
+    atomic<uint64_t> maxwaitns_{ 0 };
+    atomic<size_t> maxdepth_{ 0 };
+};
+
+#endif // MPSCQUEUE_H
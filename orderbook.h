@@ -2,14 +2,35 @@
 #define ORDERBOOK_H
 
 #include <bits/stdc++.h>
+#include "orderpool.h"
+#include "orderindex.h"
+#include "priceladder.h"
 using namespace std;
 
-enum class ordertype { Limit, Market, fillandkill };
-enum class Side { Buy, Sell };
+// Limit orders rest; Market, fillandkill (IOC) and fillorkill (FOK) only ever
+// take liquidity and drop whatever they cannot fill immediately. Stop and
+// StopLimit orders wait outside the ladder until a trade prints at or through
+// their stop price, then become Market and Limit orders respectively.
+enum class ordertype : uint8_t { Limit, Market, fillandkill, fillorkill, Stop, StopLimit };
+enum class Side : uint8_t { Buy, Sell };
+
+// What the book does when an order would trade against a resting order with
+// the same owner. None lets them trade. CancelNewest drops the incoming
+// order's remainder, CancelOldest removes the resting order and keeps
+// matching, CancelBoth does both, and Decrement takes the smaller open
+// quantity off both orders (removing whichever reaches zero) without a trade.
+enum class stpmode : uint8_t { None, CancelNewest, CancelOldest, CancelBoth, Decrement };
+
+// Outcome of addorder, cancelorder and Matchorder. Anything but Accepted
+// leaves the book exactly as it was: Duplicate is an ID already resting,
+// UnknownId one that is not, and Rejected an order the book cannot take (a
+// price off the ladder, a stop without a stop price, nothing left open).
+enum class orderstatus : uint8_t { Accepted, Duplicate, UnknownId, Rejected };
 
 struct Levelinfo {
-    int price;
-    int quantity;
+    Price price;
+    Qty quantity;
+    int orders = 0;
 };
 using Levelinfos = vector<Levelinfo>;
 
@@ -26,223 +47,836 @@ private:
     Levelinfos asks_;
 };
 
-class Order {
+// Everything the match loop reads or writes for an order, in 48 bytes, so a
+// queued order's node is its level links plus this and exactly one cache line.
+// The rest of an Order is its stop price and iceberg display quantity; only
+// orders that use them have them (hasextra()), and the book files those out
+// of line.
+class orderstate {
 public:
-    Order(ordertype otype, int id, Side side, int price, int quantity)
-        : ordertype_(otype), id_(id), side_(side), price_(price),
-        ini_quantity_(quantity), rem_quantity_(quantity) {
-    }
-    // Market order constructor: price is set to -1.
-    Order(int id, Side side, int quantity)
-        : Order(ordertype::Market, id, side, -1, quantity) {
+    // owner identifies the account or firm for self-trade prevention; 0 means
+    // none, and such orders are never stopped from trading.
+    orderstate(ordertype otype, OrderId id, Side side, Price price, Qty quantity, uint32_t owner = 0)
+        : id_(id), price_(price), ini_quantity_(quantity), rem_quantity_(quantity),
+        owner_(owner), ordertype_(otype), side_(side) {
     }
 
-    int getorderid() const { return id_; }
+    OrderId getorderid() const { return id_; }
     Side getside() const { return side_; }
-    int getprice() const { return price_; }
+    Price getprice() const { return price_; }
     ordertype getordertype() const { return ordertype_; }
-    int getini() const { return ini_quantity_; }
-    int getrem() const { return rem_quantity_; }
-    int getfilled() const { return getini() - getrem(); }
-    bool isfilled() const { return getrem() == 0; }
-
-    void fill(int quantity) {
-        if (quantity > getrem())
-            throw runtime_error("Overfill error");
+    uint32_t getowner() const { return owner_; }
+    Qty getini() const { return ini_quantity_; }
+    Qty getrem() const { return rem_quantity_; }
+    Qty getfilled() const { return getini() - getrem(); }
+    bool isfilled() const { return getrem() == Qty(0); }
+    bool hasextra() const { return hasextra_; }
+
+    bool isstop() const { return ordertype_ == ordertype::Stop || ordertype_ == ordertype::StopLimit; }
+    // Turn a triggered stop into the order it stands for.
+    void activate() { ordertype_ = ordertype_ == ordertype::Stop ? ordertype::Market : ordertype::Limit; }
+
+    // While an iceberg is queued, its open quantity splits into the slice on
+    // show and the hidden reserve behind it.
+    Qty gethidden() const { return hidden_; }
+    Qty getshown() const { return rem_quantity_ - hidden_; }
+    void sethidden(Qty hidden) { hidden_ = hidden; }
+    // Start a new displayed slice of at most display out of the open quantity
+    // (0 shows everything).
+    void slice(Qty display) {
+        if (display > Qty(0)) hidden_ = rem_quantity_ - min(display, rem_quantity_);
+    }
+
+    // The book never takes more than is open; debug builds check it.
+    void fill(Qty quantity) noexcept {
+        assert(quantity <= getrem());
         rem_quantity_ -= quantity;
     }
-private:
+    // Shrink the open quantity without counting it as filled. An iceberg
+    // gives up hidden quantity before any of its displayed slice.
+    void reduce(Qty quantity) noexcept {
+        assert(quantity <= getrem());
+        hidden_ -= min(hidden_, quantity);
+        ini_quantity_ -= quantity;
+        rem_quantity_ -= quantity;
+    }
+protected:
+    OrderId id_;
+    Price price_;
+    Qty ini_quantity_;
+    Qty rem_quantity_;
+    Qty hidden_{ 0 };
+    uint32_t owner_;
     ordertype ordertype_;
-    int id_;
     Side side_;
-    int price_;
-    int ini_quantity_;
-    int rem_quantity_;
+    bool hasextra_ = false;
 };
+static_assert(sizeof(orderstate) == 48, "order state layout");
 
-using orderptr = shared_ptr<Order>;
-using orderpointer = list<orderptr>;
+// Stop and iceberg parameters.
+struct orderextra {
+    Price stop_ = Price::none();
+    Qty display_{ 0 };
+};
 
-class ordermodify {
+class Order : public orderstate {
 public:
-    ordermodify(int id, Side side, int price, int quantity)
-        : id_(id), side_(side), price_(price), quantity_(quantity) {
+    Order(ordertype otype, OrderId id, Side side, Price price, Qty quantity, uint32_t owner = 0)
+        : orderstate(otype, id, side, price, quantity, owner) {
     }
-    int getorderid() const { return id_; }
-    Side getside() const { return side_; }
-    int getprice() const { return price_; }
-    int getquantity() const { return quantity_; }
-    orderptr toorderptr(ordertype type) const {
-        return make_shared<Order>(type, getorderid(), getside(), getprice(), getquantity());
+    // Market order constructor: the order has no limit price.
+    Order(OrderId id, Side side, Qty quantity)
+        : Order(ordertype::Market, id, side, Price::none(), quantity) {
     }
+    Order(const orderstate& state, const orderextra& extra) : orderstate(state), extra_(extra) {}
+
+    // Stop and StopLimit orders: the trade price that activates them.
+    Price getstopprice() const { return extra_.stop_; }
+    void setstopprice(Price stop) {
+        extra_.stop_ = stop;
+        markextra();
+    }
+    // Iceberg orders show at most getdisplay() in the book at a time (0 shows
+    // everything).
+    Qty getdisplay() const { return extra_.display_; }
+    void setdisplay(Qty display) {
+        extra_.display_ = display;
+        markextra();
+    }
+    void slice() { orderstate::slice(extra_.display_); }
+    const orderextra& getextra() const { return extra_; }
 private:
-    int id_;
-    int price_;
-    int quantity_;
-    Side side_;
+    void markextra() { hasextra_ = extra_.stop_ != Price::none() || extra_.display_ > Qty(0); }
+
+    orderextra extra_;
 };
+static_assert(sizeof(Order) == 64, "order layout");
+
+// Public handle type kept for callers that build orders on the heap; the book
+// copies them into its own pool on entry.
+using orderptr = shared_ptr<Order>;
 
-struct tradeinfo {
-    int id_;
-    int pprice_;
-    int quantity_;
+// Pool slot for a resting order, linked into its price level: one cache line,
+// so the match loop loads a single line for each order it passes.
+struct alignas(64) ordernode {
+    explicit ordernode(const orderstate& order) : order_(order) {}
+    orderstate order_;
+    ordernode* prev_ = nullptr;
+    ordernode* next_ = nullptr;
 };
+static_assert(sizeof(ordernode) == 64, "order node must be one cache line");
+using orderhandle = ordernode*;
 
-class trade {
+// Price level: FIFO of resting orders plus running totals, so depth queries
+// never walk the orders. quantity() is what the level displays; icebergs'
+// reserves are totalled separately in hidden(). Fills and amends of an order
+// already in the level go through reduce(); unlinking subtracts whatever the
+// order still has open.
+class orderlevel : public intrusivelist<ordernode> {
 public:
-    trade(const tradeinfo& bidtrade, const tradeinfo& asktrade)
-        : bidtrade_(bidtrade), asktrade_(asktrade) {
+    void push_back(ordernode* node) {
+        intrusivelist::push_back(node);
+        quantity_ += node->order_.getshown();
+        hidden_ += node->order_.gethidden();
+        ++count_;
+    }
+    void erase(ordernode* node) {
+        quantity_ -= node->order_.getshown();
+        hidden_ -= node->order_.gethidden();
+        --count_;
+        intrusivelist::erase(node);
+    }
+    void pop_front() { erase(front()); }
+    void reduce(Qty shown, Qty hidden = Qty(0)) {
+        quantity_ -= shown;
+        hidden_ -= hidden;
     }
-    const tradeinfo& getbidtrade() const { return bidtrade_; }
-    const tradeinfo& getasktrade() const { return asktrade_; }
+
+    Qty quantity() const { return quantity_; }
+    Qty hidden() const { return hidden_; }
+    int count() const { return count_; }
 private:
-    tradeinfo bidtrade_;
-    tradeinfo asktrade_;
+    Qty quantity_{ 0 };
+    Qty hidden_{ 0 };
+    int count_ = 0;
 };
 
+class ordermodify {
+public:
+    ordermodify(OrderId id, Side side, Price price, Qty quantity)
+        : id_(id), price_(price), quantity_(quantity), side_(side) {
+    }
+    OrderId getorderid() const { return id_; }
+    Side getside() const { return side_; }
+    Price getprice() const { return price_; }
+    Qty getquantity() const { return quantity_; }
+    Order toorder(ordertype type) const {
+        return Order(type, getorderid(), getside(), getprice(), getquantity());
+    }
+    orderptr toorderptr(ordertype type) const {
+        return make_shared<Order>(toorder(type));
+    }
+private:
+    OrderId id_;
+    Price price_;
+    Qty quantity_;
+    Side side_;     // Last, so the only padding is at the tail.
+};
+static_assert(sizeof(ordermodify) == 32, "order modify layout");
+
+// One execution between a buy and a sell order, at the resting order's price.
+// Trivially copyable and half a cache line, so sinks can queue it as is.
+struct trade {
+    OrderId bid_;
+    OrderId ask_;
+    Price price_;
+    Qty quantity_;
+};
+static_assert(sizeof(trade) == 32 && is_trivially_copyable_v<trade>, "trade layout");
+
 using trades = vector<trade>;
 
+// Open quantity self-trade prevention took off an order instead of trading
+// it. Sinks that also accept this type are told about every such reduction;
+// an order left with nothing open is no longer in the book.
+struct selftrade {
+    OrderId id_;
+    Side side_;
+    Qty quantity_;
+};
+
+// A stop order the last trade price reached, reported to sinks that accept it
+// just before the order trades as a market or limit order. A triggered Stop
+// never rests: what it cannot fill is dropped and reported as a stopexpiry.
+struct stoptrigger {
+    OrderId id_;
+    Side side_;
+    Price stop_;
+};
+struct stopexpiry {
+    OrderId id_;
+    Side side_;
+    Qty quantity_;
+};
+
+// The order an addorder or Matchorder call was given has passed every check,
+// reported to sinks that accept it before anything is matched, so an
+// acknowledgement can go out ahead of the fills. side_ is the side the order
+// now has.
+struct orderaccepted {
+    OrderId id_;
+    Side side_;
+};
+
 class Orderbook {
 private:
-    struct orderentry {
-        orderptr order_{ nullptr };
-        orderpointer::iterator location_;
-    };
-
     // Bids: descending order, Asks: ascending order.
-    map<int, orderpointer, greater<int>> bids_;
-    map<int, orderpointer, less<int>> asks_;
+    priceladder<orderlevel, greater<Price>> bids_;
+    priceladder<orderlevel, less<Price>> asks_;
 
     // Fast lookup by order ID.
-    unordered_map<int, orderentry> orders_;
+    orderindex<ordernode> orders_;
 
-    // Check if order can immediately match.
-    bool canmatch(Side side, int price_) const {
-        if (side == Side::Buy) {
-            if (asks_.empty()) return false;
-            auto it = asks_.begin();
-            return price_ >= it->first;
-        }
-        else {
-            if (bids_.empty()) return false;
-            auto it = bids_.begin();
-            return price_ <= it->first;
+    // Backing storage for every resting order.
+    objectpool<ordernode> pool_;
+
+    // Stop and iceberg parameters of the resting orders that have them, by ID.
+    // Matching never needs them, so they stay out of the nodes.
+    orderindex<orderextra> extras_;
+    objectpool<orderextra> extrapool_;
+
+    // Dormant stop orders by stop price, in trigger order: buy stops fire
+    // lowest first as prices rise, sell stops highest first as they fall. Each
+    // level queues its stops by time, like a price level.
+    map<Price, orderlevel, less<Price>> buystops_;
+    map<Price, orderlevel, greater<Price>> sellstops_;
+
+    // Price of the last trade, which is what triggers stops.
+    Price lastprice_ = Price::none();
+
+    stpmode stp_ = stpmode::None;
+
+    // Levels touched since the last consumechanges(), for market data.
+    struct levelchange {
+        Side side_;
+        Price price_;
+    };
+    vector<levelchange> changes_;
+    bool tracking_ = false;
+
+    // Price levels traded through since construction, for instrumentation.
+    uint64_t levelscrossed_ = 0;
+
+    void touch(Side side, Price price) {
+        if (tracking_) changes_.push_back(levelchange{ side, price });
+    }
+
+    // Index a new order in a fresh node, filing its stop and iceberg
+    // parameters if it has any. Returns nullptr if the ID is already resting.
+    orderhandle insert(const Order& order) {
+        orderhandle node = pool_.acquire(order);
+        if (!orders_.insert(order.getorderid(), node)) {
+            pool_.release(node);
+            return nullptr;
         }
+        if (order.hasextra()) extras_.insert(order.getorderid(), extrapool_.acquire(order.getextra()));
+        return node;
+    }
+    // Free a node that is no longer indexed or queued.
+    void release(orderhandle node) {
+        if (node->order_.hasextra()) extrapool_.release(extras_.erase(node->order_.getorderid()));
+        pool_.release(node);
+    }
+    // Replace a node's order, keeping its links and index entry.
+    void assign(orderhandle node, const Order& order) {
+        if (node->order_.hasextra()) extrapool_.release(extras_.erase(node->order_.getorderid()));
+        node->order_ = order;
+        if (order.hasextra()) extras_.insert(order.getorderid(), extrapool_.acquire(order.getextra()));
+    }
+    orderextra extra(const ordernode* node) const {
+        return node->order_.hasextra() ? *extras_.find(node->order_.getorderid()) : orderextra{};
+    }
+    Order toorder(const ordernode* node) const { return Order(node->order_, extra(node)); }
+    Price stopprice(const ordernode* node) const { return extra(node).stop_; }
+    // Start an iceberg's next displayed slice.
+    void slice(orderhandle node) {
+        if (node->order_.hasextra()) node->order_.slice(extra(node).display_);
     }
 
-    // Core matching algorithm.
-    trades matchorder() {
-        trades trades_;
-        trades_.reserve(orders_.size());
+    static bool isaggressive(ordertype type) { return type != ordertype::Limit; }
 
-        while (true) {
-            if (bids_.empty() || asks_.empty()) break;
-            auto it1 = bids_.begin();
-            int bidsprice = it1->first;
-            auto& bids = it1->second;
-            auto it2 = asks_.begin();
-            int asksprice = it2->first;
-            auto& asks = it2->second;
+    // Whether an aggressive order may trade against a resting price. A market
+    // order takes any price.
+    static bool crosses(const orderstate& order, Price resting) {
+        if (order.getordertype() == ordertype::Market) return true;
+        return order.getside() == Side::Buy ? resting <= order.getprice() : resting >= order.getprice();
+    }
 
-            if (bidsprice < asksprice) break;
+    // Fill-or-kill pre-check: sum level aggregates on the opposite side while
+    // they cross, stopping as soon as the order is covered. When self-trade
+    // prevention applies, the order's own resting orders are not liquidity:
+    // CancelOldest skips them and every other mode stops at the first one.
+    template <class Ladder>
+    bool canfill(const orderstate& order, const Ladder& opposite) const {
+        bool own = stp_ != stpmode::None && order.getowner() != 0;
+        Qty available{ 0 };
+        opposite.foreachlevel([&](Price price, const orderlevel& level) {
+            if (!crosses(order, price)) return false;
+            if (!own) {
+                available += level.quantity() + level.hidden();
+                return available < order.getrem();
+            }
+            for (orderhandle node = level.front(); node; node = node->next_) {
+                if (node->order_.getowner() == order.getowner()) {
+                    if (stp_ == stpmode::CancelOldest) continue;
+                    return false;
+                }
+                available += node->order_.getrem();
+                if (available >= order.getrem()) return false;
+            }
+            return true;
+            });
+        return available >= order.getrem();
+    }
 
-            while (!bids.empty() && !asks.empty()) {
-                auto bid = bids.front();
-                auto ask = asks.front();
+    // Match an order straight against the opposite side, best price first.
+    // The order itself is not in the ladder while it matches; the caller
+    // decides what happens to any remainder. Only the nodes' one line is
+    // touched for each resting order passed.
+    template <class Ladder, class Sink>
+    void sweep(orderstate& order, Ladder& opposite, Sink& sink) {
+        Side restingside = order.getside() == Side::Buy ? Side::Sell : Side::Buy;
+        while (!order.isfilled() && !opposite.empty() && crosses(order, opposite.bestprice())) {
+            auto& level = opposite.bestlevel();
+            touch(restingside, opposite.bestprice());
+            ++levelscrossed_;
+            while (!order.isfilled() && !level.empty()) {
+                orderhandle node = level.front();
+                orderstate& resting = node->order_;
 
-                int quantity = min(bid->getrem(), ask->getrem());
-                bid->fill(quantity);
-                ask->fill(quantity);
+                // Different owners, the normal case, cost this one compare.
+                if (__builtin_expect(resting.getowner() == order.getowner(), 0)
+                    && order.getowner() != 0 && stp_ != stpmode::None) {
+                    preventselftrade(order, node, level, sink);
+                    continue;
+                }
+
+                // An iceberg trades its displayed slice, then shows the next
+                // one at the back of the queue.
+                Qty quantity = min(order.getrem(), resting.getshown());
+                order.fill(quantity);
+                resting.fill(quantity);
+                level.reduce(quantity);
+                lastprice_ = resting.getprice();
 
-                trades_.push_back(trade(
-                    tradeinfo{ bid->getorderid(), bid->getprice(), quantity },
-                    tradeinfo{ ask->getorderid(), ask->getprice(), quantity }
-                ));
+                if (order.getside() == Side::Buy)
+                    sink(trade{ order.getorderid(), resting.getorderid(), resting.getprice(), quantity });
+                else
+                    sink(trade{ resting.getorderid(), order.getorderid(), resting.getprice(), quantity });
 
-                if (bid->isfilled()) {
-                    bids.pop_front();
-                    orders_.erase(bid->getorderid());
+                if (resting.isfilled()) {
+                    level.pop_front();
+                    orders_.erase(resting.getorderid());
+                    release(node);
                 }
-                if (ask->isfilled()) {
-                    asks.pop_front();
-                    orders_.erase(ask->getorderid());
+                else if (__builtin_expect(resting.getshown() == Qty(0), 0)) {
+                    level.pop_front();
+                    slice(node);
+                    level.push_back(node);
                 }
-                if (bids.empty()) bids_.erase(bidsprice);
-                if (asks.empty()) asks_.erase(asksprice);
             }
+            if (level.empty()) opposite.erasebest();
         }
-        return trades_;
     }
 
-public:
-    Orderbook() = default;
+    // order is about to trade with node, which has the same owner. Applies
+    // the book's STP mode; the sweep loop then carries on or stops depending
+    // on what is left open.
+    template <class Sink>
+    void preventselftrade(orderstate& order, orderhandle node, orderlevel& level, Sink& sink) {
+        orderstate& resting = node->order_;
+        Qty incoming{ 0 };
+        Qty oldest{ 0 };
+        switch (stp_) {
+        case stpmode::CancelNewest: incoming = order.getrem(); break;
+        case stpmode::CancelOldest: oldest = resting.getrem(); break;
+        case stpmode::CancelBoth: incoming = order.getrem(); oldest = resting.getrem(); break;
+        default: incoming = oldest = min(order.getrem(), resting.getrem()); break;
+        }
+        if (oldest > Qty(0)) {
+            reducequeued(resting, level, oldest);
+            reportselftrade(sink, resting, oldest);
+            if (resting.isfilled()) {
+                level.pop_front();
+                orders_.erase(resting.getorderid());
+                release(node);
+            }
+        }
+        if (incoming > Qty(0)) {
+            order.reduce(incoming);
+            reportselftrade(sink, order, incoming);
+        }
+    }
 
-    trades addorder(orderptr order) {
-        if (orders_.find(order->getorderid()) != orders_.end())
-            return {};
-        if (order->getordertype() == ordertype::fillandkill && !canmatch(order->getside(), order->getprice()))
-            return {};
-        orderpointer::iterator it;
-        if (order->getside() == Side::Buy) {
-            auto& ordersAtPrice = bids_[order->getprice()];
-            ordersAtPrice.push_back(order);
-            it = prev(ordersAtPrice.end());
+    template <class Sink>
+    static void reportselftrade(Sink& sink, const orderstate& order, Qty quantity) {
+        if constexpr (is_invocable_v<Sink&, const selftrade&>)
+            sink(selftrade{ order.getorderid(), order.getside(), quantity });
+    }
+    template <class Sink>
+    static void reportaccepted(Sink& sink, OrderId id, Side side) {
+        if constexpr (is_invocable_v<Sink&, const orderaccepted&>)
+            sink(orderaccepted{ id, side });
+    }
+
+    // Take open quantity off a queued order without a trade, keeping its
+    // level's displayed and hidden totals in step.
+    static void reducequeued(orderstate& order, orderlevel& level, Qty quantity) {
+        Qty shown = order.getshown();
+        Qty hidden = order.gethidden();
+        order.reduce(quantity);
+        level.reduce(shown - order.getshown(), hidden - order.gethidden());
+    }
+
+    // Sweep the side opposite an order that is not resting.
+    template <class Sink>
+    void take(orderstate& order, Sink& sink) {
+        if (order.getside() == Side::Buy) sweep(order, asks_, sink);
+        else sweep(order, bids_, sink);
+    }
+
+    // Queue an indexed order that has finished matching, or drop it from the
+    // index if nothing is left open.
+    void rest(orderhandle node) {
+        const orderstate& order = node->order_;
+        if (order.isfilled()) {
+            orders_.erase(order.getorderid());
+            release(node);
+            return;
         }
-        else {
-            auto& ordersAtPrice = asks_[order->getprice()];
-            ordersAtPrice.push_back(order);
-            it = prev(ordersAtPrice.end());
+        slice(node);
+        if (order.getside() == Side::Buy) bids_.push(node);
+        else asks_.push(node);
+        touch(order.getside(), order.getprice());
+    }
+
+    // Queue a dormant stop at the back of its trigger level, or unlink it.
+    void park(orderhandle node) {
+        if (node->order_.getside() == Side::Buy) buystops_[stopprice(node)].push_back(node);
+        else sellstops_[stopprice(node)].push_back(node);
+    }
+    template <class Stops>
+    void unpark(Stops& stops, orderhandle node) {
+        auto it = stops.find(stopprice(node));
+        it->second.erase(node);
+        if (it->second.empty()) stops.erase(it);
+    }
+    void unpark(orderhandle node) {
+        if (node->order_.getside() == Side::Buy) unpark(buystops_, node);
+        else unpark(sellstops_, node);
+    }
+    orderlevel& stoplevel(orderhandle node) {
+        return node->order_.getside() == Side::Buy ? buystops_.find(stopprice(node))->second
+            : sellstops_.find(stopprice(node))->second;
+    }
+
+    // Fire every stop the last trade price has reached, best trigger first.
+    // Only the front of each side is compared, so dormant stops cost nothing
+    // until the market gets to them; the trades of a triggered stop can move
+    // the price far enough to fire more.
+    template <class Sink>
+    void triggerstops(Sink& sink) {
+        if (__builtin_expect(buystops_.empty() && sellstops_.empty(), 1)) return;
+        while (lastprice_ != Price::none()) {
+            if (!buystops_.empty() && lastprice_ >= buystops_.begin()->first)
+                fire(popstop(buystops_), sink);
+            else if (!sellstops_.empty() && lastprice_ <= sellstops_.begin()->first)
+                fire(popstop(sellstops_), sink);
+            else
+                return;
         }
-        orders_.insert({ order->getorderid(), orderentry{order, it} });
-        return matchorder();
+    }
+    template <class Stops>
+    static orderhandle popstop(Stops& stops) {
+        auto it = stops.begin();
+        orderhandle node = it->second.front();
+        it->second.pop_front();
+        if (it->second.empty()) stops.erase(it);
+        return node;
+    }
+
+    // Park a new stop, checked like a limit order for its limit price.
+    template <class Sink>
+    orderstatus addstop(const Order& order, Sink& sink) {
+        if (order.getstopprice() == Price::none()
+            || (order.getordertype() == ordertype::StopLimit && !bids_.accepts(order.getprice())))
+            return orderstatus::Rejected;
+        orderhandle node = insert(order);
+        if (node == nullptr)
+            return orderstatus::Duplicate;
+        reportaccepted(sink, order.getorderid(), order.getside());
+        park(node);
+        triggerstops(sink);
+        return orderstatus::Accepted;
     }
 
-    void cancelorder(int id) {
-        if (orders_.find(id) == orders_.end()) return;
-        const auto& [order, it] = orders_.at(id);
-        orders_.erase(id);
-        if (order->getside() == Side::Sell) {
-            int price = order->getprice();
-            auto& ordersAtPrice = asks_.at(price);
-            ordersAtPrice.erase(it);
-            if (ordersAtPrice.empty())
-                asks_.erase(price);
+    // Take an order that is already out of the index off its level or
+    // trigger level and free it.
+    void remove(orderhandle node) {
+        if (node->order_.isstop()) {
+            unpark(node);
         }
         else {
-            int price = order->getprice();
-            auto& ordersAtPrice = bids_.at(price);
-            ordersAtPrice.erase(it);
-            if (ordersAtPrice.empty())
-                bids_.erase(price);
+            touch(node->order_.getside(), node->order_.getprice());
+            if (node->order_.getside() == Side::Sell) asks_.erase(node);
+            else bids_.erase(node);
         }
+        release(node);
+    }
+
+    // Matchorder on an order already looked up.
+    template <class Sink>
+    orderstatus modify(orderhandle node, const ordermodify& omod, Sink& sink) {
+        orderstate& order = node->order_;
+        bool priced = order.getordertype() != ordertype::Stop;
+        Price price = priced ? omod.getprice() : order.getprice();
+        if (priced && (price == Price::none() || !bids_.accepts(price)))
+            return orderstatus::Rejected;
+        reportaccepted(sink, omod.getorderid(), omod.getside());
+        if (omod.getquantity() <= Qty(0)) {
+            orders_.erase(omod.getorderid());
+            remove(node);
+            return orderstatus::Accepted;
+        }
+        bool dormant = order.isstop();
+        if (price == order.getprice() && omod.getside() == order.getside()
+            && omod.getquantity() <= order.getrem()) {
+            Qty delta = order.getrem() - omod.getquantity();
+            if (dormant) {
+                reducequeued(order, stoplevel(node), delta);
+                return orderstatus::Accepted;
+            }
+            reducequeued(order, order.getside() == Side::Buy ? bids_.levelat(order.getprice())
+                : asks_.levelat(order.getprice()), delta);
+            touch(order.getside(), order.getprice());
+            return orderstatus::Accepted;
+        }
+        Order replacement(order.getordertype(), omod.getorderid(), omod.getside(),
+            price, order.getfilled() + omod.getquantity(), order.getowner());
+        replacement.fill(order.getfilled());
+        replacement.setstopprice(extra(node).stop_);
+        replacement.setdisplay(extra(node).display_);
+        if (dormant) {
+            unpark(node);
+            assign(node, replacement);
+            park(node);
+            return orderstatus::Accepted;
+        }
+        // Take the node out of its level, match it as the incoming order and
+        // requeue it at the back of its new level; its index entry stays.
+        touch(order.getside(), order.getprice());
+        if (order.getside() == Side::Sell) asks_.erase(node);
+        else bids_.erase(node);
+        assign(node, replacement);
+        take(order, sink);
+        rest(node);
+        triggerstops(sink);
+        return orderstatus::Accepted;
+    }
+
+    // A triggered stop trades as the market or limit order it stands for.
+    template <class Sink>
+    void fire(orderhandle node, Sink& sink) {
+        orderstate& order = node->order_;
+        if constexpr (is_invocable_v<Sink&, const stoptrigger&>)
+            sink(stoptrigger{ order.getorderid(), order.getside(), stopprice(node) });
+        order.activate();
+        take(order, sink);
+        if (order.getordertype() == ordertype::Limit) {
+            rest(node);
+            return;
+        }
+        if (!order.isfilled()) {
+            if constexpr (is_invocable_v<Sink&, const stopexpiry&>)
+                sink(stopexpiry{ order.getorderid(), order.getside(), order.getrem() });
+        }
+        orders_.erase(order.getorderid());
+        release(node);
+    }
+
+    // Sink that collects trades for the vector-returning API.
+    struct tradecollector {
+        trades& out_;
+        void operator()(const trade& t) { out_.push_back(t); }
+    };
+
+public:
+    Orderbook() = default;
+    // Pre-size the order pool and ID index so a session up to this many resting
+    // orders never touches the allocator for order storage.
+    explicit Orderbook(size_t expectedorders) : orders_(expectedorders), pool_(expectedorders) {}
+    // Book over a bounded tick range: both sides use the array-backed ladder and
+    // orders priced off-tick or outside the range are rejected.
+    explicit Orderbook(const ladderconfig& ladder, size_t expectedorders = 0)
+        : bids_(ladder), asks_(ladder), orders_(expectedorders), pool_(expectedorders) {}
+
+    // Add an order and stream any resulting trades into sink(const trade&).
+    // Market, fillandkill and fillorkill orders trade against the opposite side
+    // and never rest; a fillorkill that cannot fill completely is accepted but
+    // does nothing. Stop orders wait for their trigger, firing at once if the
+    // last trade is already there; any stops an order's trades trigger fire
+    // before this returns.
+    //
+    // The operations below do one ID lookup each, never throw and report
+    // failure only through their status. A sink that throws terminates, as
+    // does running out of memory while growing the pool, the index or a
+    // map-backed ladder past its pre-sized capacity.
+    template <class Sink>
+    orderstatus addorder(const Order& order, Sink&& sink) noexcept {
+        if (isaggressive(order.getordertype())) {
+            if (order.isstop())
+                return addstop(order, sink);
+            if (orders_.find(order.getorderid()))
+                return orderstatus::Duplicate;
+            reportaccepted(sink, order.getorderid(), order.getside());
+            Order taker(order);
+            if (taker.getordertype() == ordertype::fillorkill
+                && !(taker.getside() == Side::Buy ? canfill(taker, asks_) : canfill(taker, bids_)))
+                return orderstatus::Accepted;
+            take(taker, sink);
+            triggerstops(sink);
+            return orderstatus::Accepted;
+        }
+        if (!bids_.accepts(order.getprice()))
+            return orderstatus::Rejected;
+        // The insert doubles as the duplicate-ID check. A limit order takes
+        // what it crosses first and rests only if something is left.
+        orderhandle node = insert(order);
+        if (node == nullptr)
+            return orderstatus::Duplicate;
+        reportaccepted(sink, order.getorderid(), order.getside());
+        take(node->order_, sink);
+        rest(node);
+        triggerstops(sink);
+        return orderstatus::Accepted;
+    }
+
+    trades addorder(const Order& order) {
+        trades result;
+        addorder(order, tradecollector{ result });
+        return result;
+    }
+
+    // Adapter for the shared_ptr API: the order is copied into the pool, so
+    // later fills are not reflected in the caller's object.
+    trades addorder(orderptr order) {
+        return addorder(*order);
+    }
+
+    // UnknownId if the order is not resting (unknown, filled or already cancelled).
+    orderstatus cancelorder(OrderId id) noexcept {
+        orderhandle node = orders_.erase(id);
+        if (node == nullptr) return orderstatus::UnknownId;
+        remove(node);
+        return orderstatus::Accepted;
+    }
+
+    // Modify an order; omod's quantity is the new open quantity, and 0 cancels
+    // it. Shrinking it at the same price and side is done in place, so the
+    // order keeps its queue position. Anything else loses priority: the order
+    // is cancelled and re-added (keeping its filled quantity) and may match. A
+    // dormant stop keeps its stop price and, having no price to rest at, a
+    // Stop ignores omod's price; it is requeued at the back of its trigger
+    // level instead of matching.
+    template <class Sink>
+    orderstatus Matchorder(const ordermodify& omod, Sink&& sink) noexcept {
+        orderhandle node = orders_.find(omod.getorderid());
+        if (node == nullptr)
+            return orderstatus::UnknownId;
+        return modify(node, omod, sink);
+    }
+
+    // Cancel/replace as FIX has it: total is the new order quantity including
+    // what has already filled, and the order keeps its side. Rejected if that
+    // leaves nothing open.
+    template <class Sink>
+    orderstatus replaceorder(OrderId id, Price price, Qty total, Sink&& sink) noexcept {
+        orderhandle node = orders_.find(id);
+        if (node == nullptr)
+            return orderstatus::UnknownId;
+        Qty open = total - node->order_.getfilled();
+        if (open <= Qty(0))
+            return orderstatus::Rejected;
+        return modify(node, ordermodify(id, node->order_.getside(), price, open), sink);
     }
 
     trades Matchorder(const ordermodify& omod) {
-        if (orders_.find(omod.getorderid()) == orders_.end())
-            return {};
-        auto entry = orders_.at(omod.getorderid());
-        auto oldOrder = entry.order_;
-        cancelorder(omod.getorderid());
-        return addorder(omod.toorderptr(oldOrder->getordertype()));
+        trades result;
+        Matchorder(omod, tradecollector{ result });
+        return result;
+    }
+
+    // Put back an order exactly as a snapshot recorded it: a queued order keeps
+    // its iceberg slice and a dormant stop stays dormant. Nothing matches, so
+    // orders must come in priority order into a book that is not crossed.
+    void restore(const Order& order) {
+        orderhandle node = insert(order);
+        if (node == nullptr)
+            return;
+        if (order.isstop()) {
+            park(node);
+            return;
+        }
+        if (order.getside() == Side::Buy) bids_.push(node);
+        else asks_.push(node);
+        touch(order.getside(), order.getprice());
+    }
+
+    // Price of the last trade, or Price::none() before the first.
+    Price lastprice() const { return lastprice_; }
+    void setlastprice(Price price) { lastprice_ = price; }
+
+    // Self-trade prevention for orders that carry an owner. Off by default.
+    void setstpmode(stpmode mode) { stp_ = mode; }
+    stpmode getstpmode() const { return stp_; }
+
+    // Whether this book can hold an order at this price (always true for a map-backed book).
+    bool acceptsprice(Price price) const { return bids_.accepts(price); }
+
+    // Copy of a resting order by ID, or nothing.
+    optional<Order> findorder(OrderId id) const {
+        orderhandle node = orders_.find(id);
+        if (node == nullptr) return nullopt;
+        return toorder(node);
+    }
+
+    // Cache hints for applying commands in batches (see applycommands). The
+    // first starts loading what an operation on id at price touches first: its
+    // index slot and, on a dense ladder, its level. The second, issued once the
+    // slot is likely cached, loads the resting order itself.
+    void prefetch(OrderId id, Side side, Price price) const {
+        orders_.prefetch(id);
+        if (side == Side::Buy) bids_.prefetch(price);
+        else asks_.prefetch(price);
+    }
+    void prefetchorder(OrderId id) const {
+        if (orderhandle node = orders_.find(id)) __builtin_prefetch(node, 1);
+    }
+
+    size_t size() const { return orders_.size(); }
+    size_t levelcount(Side side) const { return side == Side::Buy ? bids_.levelcount() : asks_.levelcount(); }
+    // Running count of price levels matched through (one per crossing level).
+    uint64_t levelscrossed() const { return levelscrossed_; }
+
+    // Record which levels each operation touches so a market-data publisher can
+    // send one update per changed level instead of one per order event.
+    void trackchanges(bool on) {
+        tracking_ = on;
+        changes_.clear();
+        if (on) changes_.reserve(64);
+    }
+
+    // Hand every level touched since the last call to f(Side, const Levelinfo&)
+    // with its current aggregate (quantity 0 once the level is gone), each level
+    // once, bids before asks. Clears the change list.
+    template <class F>
+    void consumechanges(F f) {
+        if (changes_.empty()) return;
+        sort(changes_.begin(), changes_.end(), [](const levelchange& a, const levelchange& b) {
+            return a.side_ != b.side_ ? a.side_ < b.side_ : a.price_ < b.price_;
+            });
+        for (size_t i = 0; i < changes_.size(); ++i) {
+            const levelchange& c = changes_[i];
+            if (i > 0 && c.side_ == changes_[i - 1].side_ && c.price_ == changes_[i - 1].price_) continue;
+            const orderlevel* level = c.side_ == Side::Buy ? bids_.findlevel(c.price_) : asks_.findlevel(c.price_);
+            f(c.side_, level ? Levelinfo{ c.price_, level->quantity(), level->count() } : Levelinfo{ c.price_, Qty(0), 0 });
+        }
+        changes_.clear();
+    }
+
+    // Visit every resting order in priority order (bids best-first, then asks,
+    // then dormant buy and sell stops in trigger order, each level front to
+    // back). Never allocates, so a forked child can use it.
+    template <class F>
+    void foreachorder(F f) const {
+        auto walk = [&](Price, const orderlevel& level) {
+            for (const ordernode* node = level.front(); node; node = node->next_) f(toorder(node));
+            return true;
+        };
+        bids_.foreachlevel(walk);
+        asks_.foreachlevel(walk);
+        for (const auto& [price, level] : buystops_) walk(price, level);
+        for (const auto& [price, level] : sellstops_) walk(price, level);
     }
 
     AggregatedOrderbook getorderinfo() const {
         Levelinfos bidinfo, askinfo;
-        bidinfo.reserve(orders_.size());
-        askinfo.reserve(orders_.size());
-        auto aggregator = [](int price, const orderpointer& ops) {
-            int total = accumulate(ops.begin(), ops.end(), 0,
-                [](int sum, const orderptr& o) { return sum + o->getrem(); });
-            return Levelinfo{ price, total };
-            };
-        for (auto& [price, optrs] : bids_) {
-            bidinfo.push_back(aggregator(price, optrs));
-        }
-        for (auto& [price, optrs] : asks_) {
-            askinfo.push_back(aggregator(price, optrs));
-        }
+        bidinfo.reserve(bids_.levelcount());
+        askinfo.reserve(asks_.levelcount());
+        bids_.foreachlevel([&](Price price, const orderlevel& level) {
+            bidinfo.push_back(Levelinfo{ price, level.quantity(), level.count() });
+            return true;
+            });
+        asks_.foreachlevel([&](Price price, const orderlevel& level) {
+            askinfo.push_back(Levelinfo{ price, level.quantity(), level.count() });
+            return true;
+            });
         return AggregatedOrderbook(bidinfo, askinfo);
     }
+
+    // Copy up to n best levels of one side into out, best first. Returns the
+    // number of levels written. O(n) and allocation-free, for depth publication.
+    size_t getdepth(Side side, Levelinfo* out, size_t n) const {
+        size_t written = 0;
+        auto copy = [&](Price price, const orderlevel& level) {
+            if (written == n) return false;
+            out[written++] = Levelinfo{ price, level.quantity(), level.count() };
+            return true;
+        };
+        if (side == Side::Buy) bids_.foreachlevel(copy);
+        else asks_.foreachlevel(copy);
+        return written;
+    }
 };
 
 #endif // ORDERBOOK_H
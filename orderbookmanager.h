@@ -0,0 +1,508 @@
+#ifndef ORDERBOOKMANAGER_H
+#define ORDERBOOKMANAGER_H
+
+#include "ordercommand.h"
+#include "mpscqueue.h"
+#include "journal.h"
+#include "snapshot.h"
+#include "mdfeed.h"
+#include "latency.h"
+#include <pthread.h>
+
+// Trading increments of one instrument, enforced on every command before it
+// is queued: prices must be whole ticks and quantities whole lots. stp is the
+// book's self-trade prevention mode for orders that carry an owner.
+struct instrumentspec {
+    Price ticksize{ 1 };
+    Qty lotsize{ 1 };
+    stpmode stp = stpmode::None;
+};
+
+// When an event's command arrived and when the shard emitted the event, in
+// latencyclock ticks. ingress_ is 0 if the submitter did not stamp the command.
+struct eventtiming {
+    uint64_t ingress_;
+    uint64_t emitted_;
+};
+
+// A shard's hot-path counters and latency histograms (nanoseconds). Written
+// only by its matching thread, readable from any thread while it runs.
+struct shardmetrics {
+    atomic<uint64_t> neworders_{ 0 };
+    atomic<uint64_t> cancels_{ 0 };
+    atomic<uint64_t> replaces_{ 0 };
+    atomic<uint64_t> rejects_{ 0 };     // New, cancel or replace refused by the book.
+    atomic<uint64_t> trades_{ 0 };
+    latencyhistogram inbound_;          // Ingress stamp to the matching thread picking the command up.
+    latencyhistogram match_;            // Applying the command: match, journal append, market data.
+    latencyhistogram levels_;           // Price levels crossed per command that traded (a count).
+};
+
+// Resting orders and price levels of one book after the last command applied to it.
+struct bookdepth {
+    uint64_t orders = 0;
+    uint64_t bidlevels = 0;
+    uint64_t asklevels = 0;
+};
+
+// What enablerecovery() rebuilt, summed over shards.
+struct recoverystats {
+    size_t snapshotorders = 0;  // Resting orders loaded from snapshots.
+    size_t replayed = 0;        // WAL records applied after the snapshots.
+    OrderId lastid{ 0 };        // Highest order ID in the WALs, where new IDs can continue from.
+    double seconds = 0;
+};
+
+// Owns one Orderbook per symbol and runs matching on a fixed set of worker
+// threads. Every book belongs to exactly one shard, so it is only ever touched
+// by that shard's thread and needs no locking.
+//
+// Commands reach a shard through a bounded MPSC ring, so any number of FIX
+// session threads can submit without blocking on matching. Acks and fills come
+// back through one SPSC event ring per shard, drained by a single egress thread
+// via pollevents().
+class OrderbookManager {
+public:
+    // cpus[i] is the core shard i is pinned to; shards without an entry float.
+    explicit OrderbookManager(size_t shards, vector<int> cpus = {}, size_t queuecapacity = 1 << 16) {
+        if (shards == 0)
+            throw invalid_argument("OrderbookManager: need at least one shard");
+        for (size_t i = 0; i < shards; ++i) {
+            shards_.push_back(make_unique<shard>(i, queuecapacity, queuecapacity * 2));
+            if (i < cpus.size()) shards_.back()->cpu_ = cpus[i];
+        }
+    }
+    ~OrderbookManager() { stop(); }
+
+    OrderbookManager(const OrderbookManager&) = delete;
+    OrderbookManager& operator=(const OrderbookManager&) = delete;
+
+    // Register a symbol before start(). Books are spread round-robin over shards.
+    // A dense ladder must line up with the instrument's ticks.
+    int addsymbol(const string& symbol, const ladderconfig& ladder = {}, size_t expectedorders = 0,
+        const instrumentspec& spec = {}) {
+        if (running_)
+            throw logic_error("OrderbookManager: symbols must be added before start()");
+        if (index_.count(symbol))
+            throw invalid_argument("OrderbookManager: duplicate symbol " + symbol);
+        if (spec.ticksize <= Price(0) || spec.lotsize <= Qty(0))
+            throw invalid_argument("OrderbookManager: bad tick or lot size for " + symbol);
+        if (ladder.levels > 0 && (ladder.ticksize % spec.ticksize != Price(0) || ladder.baseprice % spec.ticksize != Price(0)))
+            throw invalid_argument("OrderbookManager: ladder is not on " + symbol + "'s ticks");
+        int book = (int)books_.size();
+        books_.push_back(ladder.levels > 0 ? make_unique<Orderbook>(ladder, expectedorders)
+                                           : make_unique<Orderbook>(expectedorders));
+        books_.back()->setstpmode(spec.stp);
+        symbols_.push_back(symbol);
+        specs_.push_back(spec);
+        index_.emplace(symbol, book);
+        return book;
+    }
+
+    // Book index for a symbol, or -1 if it is not traded here.
+    int findsymbol(const string& symbol) const {
+        auto it = index_.find(symbol);
+        return it == index_.end() ? -1 : it->second;
+    }
+    const string& symbolname(int book) const { return symbols_[book]; }
+    size_t bookcount() const { return books_.size(); }
+    size_t shardcount() const { return shards_.size(); }
+    size_t shardof(int book) const { return (size_t)book % shards_.size(); }
+    const instrumentspec& spec(int book) const { return specs_[book]; }
+
+    // Whether a command respects its instrument's tick and lot size. Prices,
+    // stop prices included, must be positive. Cancels carry no price or
+    // quantity and always pass.
+    bool validate(const ordercommand& cmd) const {
+        if (cmd.book_ < 0 || (size_t)cmd.book_ >= books_.size()) return false;
+        if (cmd.type_ == commandtype::Cancel) return true;
+        const instrumentspec& sp = specs_[cmd.book_];
+        if (cmd.quantity_ <= Qty(0) || cmd.quantity_ % sp.lotsize != Qty(0)) return false;
+        if (cmd.type_ == commandtype::New) {
+            bool stop = cmd.ordertype_ == ordertype::Stop || cmd.ordertype_ == ordertype::StopLimit;
+            if (stop && (cmd.stop_ <= Price(0) || cmd.stop_ % sp.ticksize != Price(0))) return false;
+            if (cmd.display_ < Qty(0) || cmd.display_ % sp.lotsize != Qty(0)) return false;
+            if (cmd.ordertype_ == ordertype::Market || cmd.ordertype_ == ordertype::Stop) return true;
+        }
+        // A modify without a price is for a Stop, which has none.
+        else if (cmd.price_ == Price::none()) return true;
+        return cmd.price_ > Price(0) && cmd.price_ % sp.ticksize == Price(0);
+    }
+
+    // Direct book access; only safe while the workers are stopped.
+    Orderbook& getbook(int book) { return *books_[book]; }
+
+    // Record every applied command to <prefix>.<shard>.journal. Call before start().
+    void enablejournal(const string& prefix) {
+        if (running_)
+            throw logic_error("OrderbookManager: journal must be enabled before start()");
+        for (size_t i = 0; i < shards_.size(); ++i)
+            shards_[i]->journal_ = make_unique<journalwriter>(prefix + "." + to_string(i) + ".journal");
+    }
+
+    // Crash recovery. For each shard, load <prefix>.<shard>.snapshot if there
+    // is one, replay the rest of <prefix>.<shard>.wal on top, then keep
+    // appending to that WAL with group commit. From then on pollevents() only
+    // releases a command's acks and fills once its WAL record is synced. Every
+    // snapshotinterval commands each shard forks a snapshot of its books
+    // without pausing matching (0 disables). Books are identified by index, so
+    // call this after registering the same symbols in the same order as the
+    // previous run, and before start().
+    recoverystats enablerecovery(const string& prefix, size_t snapshotinterval = 1000000) {
+        if (running_)
+            throw logic_error("OrderbookManager: recovery must be enabled before start()");
+        recoverystats stats;
+        auto start = chrono::steady_clock::now();
+        for (auto& sp : shards_) {
+            shard& s = *sp;
+            if (s.journal_)
+                throw logic_error("OrderbookManager: recovery replaces the journal, enable only one");
+            for (size_t b = s.id_; b < books_.size(); b += shards_.size())
+                s.books_.push_back((int)b);
+            string base = prefix + "." + to_string(s.id_);
+            s.applied_ = recover(s, base, stats);
+            s.journal_ = make_unique<journalwriter>(base + ".wal", journalmode::Durable);
+            s.gated_ = true;
+            s.staged_.reserve(256);
+            if (snapshotinterval > 0) {
+                s.snap_ = make_unique<snapshotter>(base + ".snapshot");
+                s.snapshotinterval_ = snapshotinterval;
+            }
+        }
+        stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return stats;
+    }
+
+    // Publish incremental market data for every shard. With a non-empty
+    // shmprefix each shard also writes the shared-memory feed
+    // <shmprefix>.<shard> (a POSIX shm name, so shmprefix starts with '/').
+    // A snapshot of every book in the shard goes out each snapshotinterval
+    // commands (0 disables snapshots). Call before start().
+    void enablemarketdata(const string& shmprefix = "", size_t snapshotinterval = 10000, size_t snapshotdepth = 16) {
+        if (running_)
+            throw logic_error("OrderbookManager: market data must be enabled before start()");
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            shards_[i]->md_ = make_unique<mdpublisher>(snapshotinterval, snapshotdepth);
+            if (!shmprefix.empty()) shards_[i]->md_->attachshm(shmprefix + "." + to_string(i));
+        }
+    }
+
+    // In-process market-data subscriber. f runs on the shard threads (one
+    // shard's messages are always delivered in order from the same thread).
+    void subscribemarketdata(mdpublisher::subscriber f) {
+        if (running_)
+            throw logic_error("OrderbookManager: subscribe before start()");
+        for (auto& s : shards_)
+            if (s->md_) s->md_->subscribe(f);
+    }
+
+    void start() {
+        if (running_.exchange(true)) return;
+        latencyclock::nspertick();
+        gauges_ = make_unique<bookgauge[]>(books_.size());
+        for (size_t b = 0; b < books_.size(); ++b)
+            books_[b]->trackchanges(shards_[shardof((int)b)]->md_ != nullptr);
+        for (auto& s : shards_)
+            s->worker_ = thread([this, sh = s.get()] { run(*sh); });
+    }
+
+    // Workers drain whatever is still queued before exiting.
+    void stop() {
+        if (!running_.exchange(false)) return;
+        for (auto& s : shards_)
+            if (s->worker_.joinable()) s->worker_.join();
+    }
+
+    // After stop(): wait for snapshots still being written.
+    void waitsnapshots() {
+        for (auto& s : shards_)
+            if (s->snap_) s->snap_->wait();
+    }
+    // Snapshots a shard has completed, and how long its last fork() paused
+    // matching. Read after stop() and waitsnapshots().
+    uint64_t snapshotswritten(size_t shard) const { return shards_[shard]->snap_ ? shards_[shard]->snap_->written() : 0; }
+    uint64_t snapshotpausens(size_t shard) const { return shards_[shard]->snap_ ? shards_[shard]->snap_->pausens() : 0; }
+
+    // Route a command to the shard owning its book. Safe from any thread.
+    // Returns false if the book is unknown, the command fails validate() or
+    // the shard's ring is full.
+    bool submit(const ordercommand& cmd) {
+        if (!validate(cmd)) return false;
+        return shards_[shardof(cmd.book_)]->ingress_.push(cmd);
+    }
+
+    // Drain pending execution events from every shard into f(const execevent&),
+    // or f(const execevent&, const eventtiming&) to also get the event's
+    // timestamps. Single consumer only. With recovery enabled, events wait
+    // until their command is in the synced WAL.
+    template <class F>
+    size_t pollevents(F f) {
+        size_t n = 0;
+        for (auto& s : shards_) {
+            uint64_t committed = s->gated_ ? s->journal_->committed() : numeric_limits<uint64_t>::max();
+            while (const sequencedevent* e = s->events_.front()) {
+                if (e->seq_ > committed) break;
+                if constexpr (is_invocable_v<F&, const execevent&, const eventtiming&>) f(e->ev_, e->timing_);
+                else f(e->ev_);
+                s->events_.popfront();
+                ++n;
+            }
+        }
+        return n;
+    }
+
+    // Backpressure on a shard's ingress ring.
+    ringstats ingressstats(size_t shard) const { return shards_[shard]->ingress_.stats(); }
+    // Events waiting for the egress thread, and how often the shard had to wait for room.
+    size_t eventdepth(size_t shard) const { return shards_[shard]->events_.size(); }
+    uint64_t eventstalls(size_t shard) const { return shards_[shard]->eventstalls_.load(memory_order_relaxed); }
+
+    const shardmetrics& metrics(size_t shard) const { return shards_[shard]->metrics_; }
+    // Depth of a book as of its last command; all zero before start().
+    bookdepth depth(int book) const {
+        if (!gauges_) return {};
+        const bookgauge& g = gauges_[book];
+        return bookdepth{ g.orders_.load(memory_order_relaxed), g.bidlevels_.load(memory_order_relaxed),
+            g.asklevels_.load(memory_order_relaxed) };
+    }
+
+    // Human-readable counters, latency percentiles and depth for every shard
+    // and book. Safe from any thread while running.
+    void writestats(ostream& os) const {
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            const shard& s = *shards_[i];
+            const shardmetrics& m = s.metrics_;
+            ringstats ring = s.ingress_.stats();
+            os << "shard " << i << ": new=" << m.neworders_.load(memory_order_relaxed)
+               << " cancel=" << m.cancels_.load(memory_order_relaxed)
+               << " replace=" << m.replaces_.load(memory_order_relaxed)
+               << " reject=" << m.rejects_.load(memory_order_relaxed)
+               << " trades=" << m.trades_.load(memory_order_relaxed)
+               << " dropped=" << ring.dropped << " queued=" << ring.depth
+               << " eventstalls=" << s.eventstalls_.load(memory_order_relaxed) << '\n';
+            string prefix = "shard " + to_string(i) + " ";
+            writesummary(os, prefix + "inbound", m.inbound_.summary());
+            writesummary(os, prefix + "match", m.match_.summary());
+            writesummary(os, prefix + "levels/match", m.levels_.summary(), "");
+        }
+        for (size_t b = 0; b < books_.size(); ++b) {
+            bookdepth d = depth((int)b);
+            os << "book " << symbols_[b] << ": orders=" << d.orders << " bidlevels=" << d.bidlevels
+               << " asklevels=" << d.asklevels << '\n';
+        }
+    }
+
+private:
+    // An event tagged with the shard position (1-based) of the command that caused it.
+    struct sequencedevent {
+        uint64_t seq_;
+        execevent ev_;
+        eventtiming timing_;
+    };
+
+    struct bookgauge {
+        atomic<uint64_t> orders_{ 0 };
+        atomic<uint64_t> bidlevels_{ 0 };
+        atomic<uint64_t> asklevels_{ 0 };
+    };
+
+    struct shard {
+        shard(size_t id, size_t capacity, size_t eventcapacity) : id_(id), ingress_(capacity), events_(eventcapacity) {}
+        size_t id_;
+        mpscqueue<ordercommand> ingress_;
+        spscqueue<sequencedevent> events_;
+        atomic<uint64_t> eventstalls_{ 0 };
+        shardmetrics metrics_;
+        uint64_t stamp_ = 0;        // Ingress stamp of the command being applied.
+        uint64_t applied_ = 0;      // Commands applied, counting those recovered.
+        unique_ptr<journalwriter> journal_;
+        bool gated_ = false;        // Hold events until the WAL has committed them.
+        vector<sequencedevent> staged_; // A gated command's events, pushed after its WAL append.
+        unique_ptr<snapshotter> snap_;
+        vector<int> books_;         // Books this shard owns (recovery only).
+        size_t snapshotinterval_ = 0;
+        size_t sincesnapshot_ = 0;
+        unique_ptr<mdpublisher> md_;
+        thread worker_;
+        int cpu_ = -1;
+    };
+
+    // Rebuild one shard's books from its snapshot and WAL. Returns the number
+    // of WAL records, which is where the shard's sequence continues.
+    uint64_t recover(shard& s, const string& base, recoverystats& stats) {
+        struct stat st;
+        if (::stat((base + ".wal").c_str(), &st) != 0) return 0;
+        journalreader wal(base + ".wal");
+        // The WAL is never truncated, so it has every ID ever used.
+        for (const journalrecord* rec = wal.begin(); rec != wal.end(); ++rec)
+            stats.lastid = OrderId(max(stats.lastid.value(), rec->id_));
+        auto owned = [&](int b) {
+            if (b < 0 || (size_t)b >= books_.size() || shardof(b) != s.id_)
+                throw runtime_error("OrderbookManager: " + base + " does not match the configured symbols");
+        };
+        uint64_t from = 0;
+        // A snapshot ahead of the synced WAL (crash right after it was renamed)
+        // would contain commands that were never acknowledged; replay everything.
+        if (::stat((base + ".snapshot").c_str(), &st) == 0) {
+            snapshotreader snap(base + ".snapshot");
+            if (snap.seq() <= wal.size()) {
+                snap.foreachbook([&](const snapshotbook& bh, const snapshotorder* begin, const snapshotorder* end) {
+                    int b = bh.book_;
+                    owned(b);
+                    books_[b]->setlastprice(Price(bh.lastprice_));
+                    for (const snapshotorder* o = begin; o != end; ++o)
+                        books_[b]->restore(toorder(*o));
+                    stats.snapshotorders += end - begin;
+                    });
+                from = snap.seq();
+            }
+        }
+        for (const journalrecord* rec = wal.begin() + from; rec != wal.end(); ++rec) {
+            if (rec->book_ < 0) continue;
+            owned(rec->book_);
+            filldigest digest;
+            applycommand(*books_[rec->book_], tocommand(*rec), [&](const execevent& ev) { digest.add(ev); });
+            if (digest.hash_ != rec->digest_)
+                throw runtime_error("OrderbookManager: " + base + ".wal diverged at record " + to_string(rec - wal.begin()));
+            ++stats.replayed;
+        }
+        return wal.size();
+    }
+
+    // Fills are never dropped while running: if the egress thread falls behind
+    // the shard waits for room. Once stopping, nobody may be draining, so give up.
+    void emit(shard& s, const execevent& execev) { push(s, stamped(s, execev)); }
+    sequencedevent stamped(const shard& s, const execevent& ev) const {
+        return sequencedevent{ s.applied_, ev, eventtiming{ s.stamp_, latencyclock::now() } };
+    }
+    void push(shard& s, const sequencedevent& ev) {
+        if (s.events_.push(ev)) return;
+        s.eventstalls_.fetch_add(1, memory_order_relaxed);
+        while (!s.events_.push(ev)) {
+            if (!running_.load(memory_order_acquire)) return;
+            cpurelax();
+        }
+    }
+
+    // Commands are drained in batches of whatever is already queued (never
+    // waiting for more), so under load the books' cache misses for the next few
+    // commands are prefetched while the current one is matched; see
+    // forprefetched. A lone command is applied as soon as it is popped.
+    static constexpr size_t batchsize = 16;
+
+    void run(shard& s) {
+        if (s.cpu_ >= 0) pin(s.cpu_);
+        ordercommand batch[batchsize];
+        int idle = 0;
+        while (true) {
+            size_t n = 0;
+            while (n < batchsize && s.ingress_.pop(batch[n])) ++n;
+            if (n) {
+                idle = 0;
+                forprefetched(batch, n, [this](const ordercommand& cmd) -> Orderbook& { return *books_[cmd.book_]; },
+                    [&](const ordercommand& cmd) {
+                        uint64_t start = latencyclock::now();
+                        if (cmd.stamp_ && start > cmd.stamp_) s.metrics_.inbound_.record(latencyclock::tons(start - cmd.stamp_));
+                        s.stamp_ = cmd.stamp_;
+                        apply(s, cmd);
+                        s.metrics_.match_.record(latencyclock::tons(latencyclock::now() - start));
+                    });
+                continue;
+            }
+            if (!running_.load(memory_order_acquire)) break;
+            if (++idle < 1024) cpurelax();
+            else this_thread::yield();
+        }
+    }
+
+    void apply(shard& s, const ordercommand& cmd) {
+        Orderbook& book = *books_[cmd.book_];
+        ++s.applied_;
+        uint64_t levels = book.levelscrossed();
+        uint64_t fills = 0;
+        bool rejected = false;
+        // Counted before the event is pushed: the first status event is
+        // released to the egress thread at once.
+        auto count = [&](const execevent& ev) {
+            fills += ev.type_ == eventtype::Fill;
+            rejected |= ev.type_ == eventtype::Rejected || ev.type_ == eventtype::CancelRejected
+                || ev.type_ == eventtype::ReplaceRejected;
+        };
+        if (!s.journal_ && !s.md_) {
+            applycommand(book, cmd, [&](const execevent& ev) {
+                count(ev);
+                emit(s, ev);
+                });
+            record(s, cmd, book, levels, fills, rejected);
+            return;
+        }
+        filldigest digest;
+        OrderId taker = cmd.id_;
+        applycommand(book, cmd, [&](const execevent& ev) {
+            count(ev);
+            digest.add(ev);
+            // Each trade yields a Buy and a Sell fill; tick once, from the
+            // aggressor's: the command's order or a stop it triggered.
+            if (ev.type_ == eventtype::Triggered) taker = ev.id_;
+            if (s.md_ && ev.type_ == eventtype::Fill && ev.id_ == taker)
+                s.md_->trade(cmd.book_, ev.side_, ev.price_, ev.quantity_);
+            if (s.gated_) s.staged_.push_back(stamped(s, ev));
+            else emit(s, ev);
+            });
+        if (s.journal_) s.journal_->append(makerecord(cmd, digest, nowns()));
+        // None of a gated command's events can be released before its record
+        // is appended, so pushing them earlier would wait forever on a command
+        // with more events than the ring holds.
+        for (const sequencedevent& ev : s.staged_) push(s, ev);
+        s.staged_.clear();
+        if (s.snap_ && ++s.sincesnapshot_ >= s.snapshotinterval_) {
+            // While the last snapshot is still being written, try again a little
+            // later instead of polling the child on every command.
+            s.sincesnapshot_ = s.snap_->take(s.applied_, s.books_, books_)
+                ? 0 : s.snapshotinterval_ - min<size_t>(s.snapshotinterval_, 1024);
+        }
+        if (s.md_) {
+            s.md_->endcommand(cmd.book_, book);
+            if (s.md_->snapshotdue())
+                for (size_t b = s.id_; b < books_.size(); b += shards_.size())
+                    s.md_->snapshot((int)b, *books_[b]);
+        }
+        record(s, cmd, book, levels, fills, rejected);
+    }
+
+    // Per-command counters and the book's depth gauges.
+    void record(shard& s, const ordercommand& cmd, const Orderbook& book, uint64_t levels, uint64_t fills, bool rejected) {
+        shardmetrics& m = s.metrics_;
+        bump(cmd.type_ == commandtype::New ? m.neworders_ : cmd.type_ == commandtype::Cancel ? m.cancels_ : m.replaces_);
+        if (rejected) bump(m.rejects_);
+        if (fills) {
+            bump(m.trades_, fills / 2);
+            m.levels_.record(book.levelscrossed() - levels);
+        }
+        bookgauge& g = gauges_[cmd.book_];
+        g.orders_.store(book.size(), memory_order_relaxed);
+        g.bidlevels_.store(book.levelcount(Side::Buy), memory_order_relaxed);
+        g.asklevels_.store(book.levelcount(Side::Sell), memory_order_relaxed);
+    }
+
+    static void pin(int cpu) {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+        (void)cpu;
+#endif
+    }
+
+    vector<unique_ptr<Orderbook>> books_;
+    vector<string> symbols_;
+    vector<instrumentspec> specs_;
+    unordered_map<string, int> index_;
+    vector<unique_ptr<shard>> shards_;
+    unique_ptr<bookgauge[]> gauges_;    // One per book, allocated by start().
+    atomic<bool> running_{ false };
+};
+
+#endif // ORDERBOOKMANAGER_H
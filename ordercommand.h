@@ -0,0 +1,143 @@
+#ifndef ORDERCOMMAND_H
+#define ORDERCOMMAND_H
+
+#include "orderbook.h"
+
+enum class commandtype : uint8_t { New, Cancel, Modify };
+
+// Pre-parsed order command. This is what crosses thread boundaries into the
+// matching engine, so it stays a small trivially copyable record.
+struct ordercommand {
+    commandtype type_;
+    ordertype ordertype_;
+    Side side_;
+    int book_;      // Target book index (see OrderbookManager::addsymbol).
+    OrderId id_;
+    Price price_;
+    Qty quantity_;
+    uint32_t owner_ = 0;    // Self-trade prevention owner (New only); 0 for none.
+    uint64_t stamp_ = 0;    // latencyclock ticks when the message arrived; 0 if not timed.
+    Price stop_ = Price::none();    // Stop price (New Stop and StopLimit only).
+    Qty display_{ 0 };      // Iceberg display quantity (New only); 0 shows it all.
+};
+
+enum class eventtype : uint8_t { New, Rejected, Fill, Cancelled, Replaced, CancelRejected, ReplaceRejected, Expired, SelfTrade, Triggered };
+
+// Execution event handed back from the matching thread to the FIX layer. Every
+// command produces exactly one status event (New/Rejected, Cancelled/
+// CancelRejected, Replaced/ReplaceRejected), followed by one Fill per side of
+// every trade it caused. A Market, fillandkill or fillorkill order that is not
+// completely filled ends with an Expired event carrying the dropped quantity.
+// SelfTrade events (after the status event, between fills) report open
+// quantity that self-trade prevention took off either order. A stop order the
+// command's trades set off reports Triggered, then its own fills and, for a
+// Stop, an Expired event for whatever it could not fill; these come before
+// the command's own Expired event.
+struct execevent {
+    eventtype type_;
+    Side side_;
+    int book_;
+    OrderId id_;
+    Price price_;   // Order price for status events, execution price for Fill,
+                    // stop price for Triggered.
+    Qty quantity_;  // Total order quantity for New/Replaced, fill size for Fill,
+                    // unfilled remainder for Expired, quantity removed for SelfTrade.
+};
+
+// Apply one command to a book, reporting the outcome through emit(const execevent&).
+// For Modify, quantity_ is the new total order quantity (as in a FIX
+// OrderCancelReplaceRequest); the open quantity is what remains after fills so far.
+// The status event is emitted before matching and fills are streamed straight
+// from the match loop, so nothing is allocated per command.
+template <class Emit>
+void applycommand(Orderbook& ob, const ordercommand& cmd, Emit&& emit) {
+    Qty filled{ 0 };    // Incoming order's quantity filled or removed by self-trade prevention.
+    OrderId taker = cmd.id_;    // Order now taking liquidity: the command's, then each triggered stop.
+    auto fills = [&](const auto& e) {
+        using event = decay_t<decltype(e)>;
+        if constexpr (is_same_v<event, trade>) {
+            emit(execevent{ eventtype::Fill, Side::Buy, cmd.book_, e.bid_, e.price_, e.quantity_ });
+            emit(execevent{ eventtype::Fill, Side::Sell, cmd.book_, e.ask_, e.price_, e.quantity_ });
+            if (taker == cmd.id_) filled += e.quantity_;
+        }
+        else if constexpr (is_same_v<event, selftrade>) {
+            emit(execevent{ eventtype::SelfTrade, e.side_, cmd.book_, e.id_, Price(0), e.quantity_ });
+            if (e.id_ == cmd.id_) filled += e.quantity_;
+        }
+        else if constexpr (is_same_v<event, orderaccepted>) {
+            emit(execevent{ cmd.type_ == commandtype::New ? eventtype::New : eventtype::Replaced,
+                e.side_, cmd.book_, cmd.id_, cmd.price_, cmd.quantity_ });
+        }
+        else if constexpr (is_same_v<event, stoptrigger>) {
+            taker = e.id_;
+            emit(execevent{ eventtype::Triggered, e.side_, cmd.book_, e.id_, e.stop_, Qty(0) });
+        }
+        else {
+            emit(execevent{ eventtype::Expired, e.side_, cmd.book_, e.id_, Price(0), e.quantity_ });
+        }
+    };
+    switch (cmd.type_) {
+    case commandtype::New: {
+        // The book checks the order and reports it accepted, which emits New,
+        // before it matches; anything it refuses has changed nothing.
+        Order order(cmd.ordertype_, cmd.id_, cmd.side_, cmd.price_, cmd.quantity_, cmd.owner_);
+        order.setstopprice(cmd.stop_);
+        order.setdisplay(cmd.display_);
+        if (ob.addorder(order, fills) != orderstatus::Accepted) {
+            emit(execevent{ eventtype::Rejected, cmd.side_, cmd.book_, cmd.id_, cmd.price_, cmd.quantity_ });
+            return;
+        }
+        // A Limit rests what is left; a triggered Stop's remainder is reported by the book.
+        if (cmd.ordertype_ != ordertype::Limit && !order.isstop() && filled < cmd.quantity_)
+            emit(execevent{ eventtype::Expired, cmd.side_, cmd.book_, cmd.id_, cmd.price_, cmd.quantity_ - filled });
+        return;
+    }
+    case commandtype::Cancel: {
+        bool cancelled = ob.cancelorder(cmd.id_) == orderstatus::Accepted;
+        emit(execevent{ cancelled ? eventtype::Cancelled : eventtype::CancelRejected,
+            cmd.side_, cmd.book_, cmd.id_, Price(0), Qty(0) });
+        return;
+    }
+    case commandtype::Modify: {
+        // Replaced (with the resting order's side) is emitted on acceptance,
+        // as for New. A Stop has no limit price, so the one in a modify is
+        // ignored.
+        if (ob.replaceorder(cmd.id_, cmd.price_, cmd.quantity_, fills) != orderstatus::Accepted)
+            emit(execevent{ eventtype::ReplaceRejected, cmd.side_, cmd.book_, cmd.id_, cmd.price_, cmd.quantity_ });
+        return;
+    }
+    }
+}
+
+// Call apply(cmd) for each of n commands in order, prefetching ahead: while
+// one command is applied, the index slot and dense level for a later one and
+// the resting order for the next one are already being loaded, so the cache
+// misses of a large book overlap instead of being paid one after another.
+// book(cmd) is the Orderbook a command targets, so a batch may span books.
+template <class Book, class Apply>
+void forprefetched(const ordercommand* cmds, size_t n, Book&& book, Apply&& apply) {
+    constexpr size_t ahead = 4;
+    auto prefetch = [&](const ordercommand& cmd) { book(cmd).prefetch(cmd.id_, cmd.side_, cmd.price_); };
+    for (size_t i = 0; i < n && i < ahead; ++i) prefetch(cmds[i]);
+    for (size_t i = 0; i < n; ++i) {
+        if (i + ahead < n) prefetch(cmds[i + ahead]);
+        if (i + 1 < n && cmds[i + 1].type_ != commandtype::New) book(cmds[i + 1]).prefetchorder(cmds[i + 1].id_);
+        apply(cmds[i]);
+    }
+}
+
+// Apply n commands to one book, in order, with exactly the events n
+// applycommand calls would emit. The work per command is the same; what the
+// batch buys is the lookahead of forprefetched.
+template <class Emit>
+void applycommands(Orderbook& ob, const ordercommand* cmds, size_t n, Emit&& emit) {
+    forprefetched(cmds, n, [&](const ordercommand&) -> Orderbook& { return ob; },
+        [&](const ordercommand& cmd) { applycommand(ob, cmd, emit); });
+}
+
+// Batch into one buffer: the events of all n commands are appended to out.
+inline void applycommands(Orderbook& ob, const ordercommand* cmds, size_t n, vector<execevent>& out) {
+    applycommands(ob, cmds, n, [&](const execevent& ev) { out.push_back(ev); });
+}
+
+#endif // ORDERCOMMAND_H
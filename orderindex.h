@@ -0,0 +1,103 @@
+#ifndef ORDERINDEX_H
+#define ORDERINDEX_H
+
+#include <bits/stdc++.h>
+#include "fixedpoint.h"
+using namespace std;
+
+// Order ID -> resting order handle, as one flat open-addressing table with
+// linear probing. Key and handle sit inline in a 16-byte slot, so a lookup is
+// a hash, one cache line and usually no second probe. Erase shifts the rest of
+// the probe run back instead of leaving tombstones, so lookups never slow down
+// as orders come and go.
+//
+// Size it for the session's peak resting orders up front: the table keeps its
+// load at or below half and only rehashes if that estimate is exceeded.
+template <class T>
+class orderindex {
+public:
+    orderindex() : orderindex(0) {}
+    explicit orderindex(size_t expected) {
+        size_t capacity = 16;
+        while (capacity < expected * 2) capacity <<= 1;
+        resize(capacity);
+    }
+    orderindex(const orderindex&) = delete;
+    orderindex& operator=(const orderindex&) = delete;
+
+    // Handle for id, or nullptr.
+    T* find(OrderId id) const {
+        for (size_t i = home(id);; i = (i + 1) & mask_) {
+            const slot& s = slots_[i];
+            if (s.value_ == nullptr) return nullptr;
+            if (s.key_ == id.value()) return s.value_;
+        }
+    }
+
+    // Insert id -> value. Returns false, leaving the table unchanged, if id is
+    // already present.
+    bool insert(OrderId id, T* value) {
+        if (size_ + 1 > (mask_ + 1) / 2) resize((mask_ + 1) * 2);
+        size_t i = home(id);
+        for (; slots_[i].value_ != nullptr; i = (i + 1) & mask_)
+            if (slots_[i].key_ == id.value()) return false;
+        slots_[i] = slot{ id.value(), value };
+        ++size_;
+        return true;
+    }
+
+    // Remove id and return its handle, or nullptr if it was not present.
+    T* erase(OrderId id) {
+        size_t i = home(id);
+        for (;; i = (i + 1) & mask_) {
+            if (slots_[i].value_ == nullptr) return nullptr;
+            if (slots_[i].key_ == id.value()) break;
+        }
+        T* value = slots_[i].value_;
+        // Backward-shift: pull later entries of the run into the hole unless
+        // that would move them in front of their home slot.
+        for (size_t j = (i + 1) & mask_; slots_[j].value_ != nullptr; j = (j + 1) & mask_) {
+            size_t h = homeslot(slots_[j].key_);
+            if (((j - h) & mask_) >= ((j - i) & mask_)) {
+                slots_[i] = slots_[j];
+                i = j;
+            }
+        }
+        slots_[i] = slot{};
+        --size_;
+        return value;
+    }
+
+    // Start loading id's home slot ahead of a find, insert or erase.
+    void prefetch(OrderId id) const { __builtin_prefetch(&slots_[home(id)], 1); }
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    struct slot {
+        uint64_t key_ = 0;
+        T* value_ = nullptr; // nullptr marks an empty slot.
+    };
+
+    // Fibonacci hashing: sequential IDs spread over the whole table.
+    size_t homeslot(uint64_t key) const { return (size_t)((key * 0x9E3779B97F4A7C15ull) >> shift_); }
+    size_t home(OrderId id) const { return homeslot(id.value()); }
+
+    void resize(size_t capacity) {
+        vector<slot> old = move(slots_);
+        slots_.assign(capacity, slot{});
+        mask_ = capacity - 1;
+        shift_ = 64 - __builtin_ctzll(capacity);
+        size_ = 0;
+        for (const slot& s : old)
+            if (s.value_ != nullptr) insert(OrderId(s.key_), s.value_);
+    }
+
+    vector<slot> slots_;
+    size_t mask_ = 0;
+    int shift_ = 64;
+    size_t size_ = 0;
+};
+
+#endif // ORDERINDEX_H
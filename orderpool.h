@@ -0,0 +1,94 @@
+#ifndef ORDERPOOL_H
+#define ORDERPOOL_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// Slab allocator for fixed-size objects. Slots are carved out of chunks that are
+// never handed back to the heap, so once the pool has grown to the working set
+// acquire/release are just a freelist pop/push.
+template <class T, size_t ChunkSize = 4096>
+class objectpool {
+    static_assert(is_trivially_destructible_v<T>, "pool does not run destructors on teardown");
+public:
+    objectpool() = default;
+    explicit objectpool(size_t reserve) {
+        while (capacity_ < reserve) grow();
+    }
+    objectpool(const objectpool&) = delete;
+    objectpool& operator=(const objectpool&) = delete;
+
+    template <class... Args>
+    T* acquire(Args&&... args) {
+        if (free_ == nullptr) grow();
+        slot* s = free_;
+        free_ = s->next_;
+        ++live_;
+        return new (s->storage_) T(forward<Args>(args)...);
+    }
+
+    void release(T* p) {
+        slot* s = reinterpret_cast<slot*>(p);
+        s->next_ = free_;
+        free_ = s;
+        --live_;
+    }
+
+    size_t size() const { return live_; }
+    size_t capacity() const { return capacity_; }
+
+private:
+    union slot {
+        slot* next_;
+        alignas(T) unsigned char storage_[sizeof(T)];
+    };
+
+    void grow() {
+        chunks_.push_back(make_unique<slot[]>(ChunkSize));
+        slot* chunk = chunks_.back().get();
+        for (size_t i = ChunkSize; i-- > 0;) {
+            chunk[i].next_ = free_;
+            free_ = &chunk[i];
+        }
+        capacity_ += ChunkSize;
+    }
+
+    vector<unique_ptr<slot[]>> chunks_;
+    slot* free_ = nullptr;
+    size_t live_ = 0;
+    size_t capacity_ = 0;
+};
+
+// Intrusive FIFO queue. T carries its own prev_/next_ links, so linking and
+// unlinking never allocate and erase from the middle is O(1).
+template <class T>
+class intrusivelist {
+public:
+    bool empty() const { return head_ == nullptr; }
+    T* front() const { return head_; }
+    T* back() const { return tail_; }
+
+    void push_back(T* node) {
+        node->prev_ = tail_;
+        node->next_ = nullptr;
+        if (tail_) tail_->next_ = node;
+        else head_ = node;
+        tail_ = node;
+    }
+
+    void pop_front() { erase(head_); }
+
+    void erase(T* node) {
+        if (node->prev_) node->prev_->next_ = node->next_;
+        else head_ = node->next_;
+        if (node->next_) node->next_->prev_ = node->prev_;
+        else tail_ = node->prev_;
+        node->prev_ = node->next_ = nullptr;
+    }
+
+private:
+    T* head_ = nullptr;
+    T* tail_ = nullptr;
+};
+
+#endif // ORDERPOOL_H
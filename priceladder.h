@@ -0,0 +1,193 @@
+#ifndef PRICELADDER_H
+#define PRICELADDER_H
+
+#include "fixedpoint.h"
+
+// Tick range for the array-backed ladder. levels == 0 selects the std::map
+// backend, which accepts any price.
+struct ladderconfig {
+    Price baseprice{ 0 };
+    Price ticksize{ 1 };
+    int levels = 0;
+};
+
+// One side of the book: price -> FIFO of resting orders, kept in priority order
+// (Compare is greater<Price> for bids, less<Price> for asks).
+//
+// The dense backend stores levels in a flat array indexed by
+// (price - baseprice) / ticksize, with a two-level occupancy bitmap so the next
+// non-empty level after the best one is found with a couple of bit scans. The
+// best index is cached, so matching never searches.
+template <class Level, class Compare>
+class priceladder {
+    static constexpr bool descending = is_same_v<Compare, greater<Price>>;
+public:
+    priceladder() = default;
+    explicit priceladder(const ladderconfig& config) : config_(config) {
+        if (config.levels < 0 || config.ticksize <= Price(0))
+            throw invalid_argument("priceladder: bad ladder config");
+        if (config.levels > 0) {
+            dense_ = true;
+            levels_.resize(config.levels);
+            words_.resize((config.levels + 63) / 64);
+            summary_.resize((words_.size() + 63) / 64);
+        }
+    }
+
+    bool isdense() const { return dense_; }
+    const ladderconfig& config() const { return config_; }
+
+    // Whether a price can be held by this ladder (on-tick and in range for the dense backend).
+    bool accepts(Price price) const {
+        if (!dense_) return true;
+        // Compare before subtracting: Price::none() is far below any base.
+        if (price < config_.baseprice) return false;
+        Price offset = price - config_.baseprice;
+        return offset % config_.ticksize == Price(0) && offset / config_.ticksize < config_.levels;
+    }
+
+    // Start loading the dense level for price ahead of a push or erase there;
+    // a no-op for the map backend or a price the ladder cannot hold.
+    void prefetch(Price price) const {
+        if (dense_ && accepts(price)) __builtin_prefetch(&levels_[indexof(price)], 1);
+    }
+
+    bool empty() const { return dense_ ? best_ < 0 : map_.empty(); }
+    size_t levelcount() const { return dense_ ? occupied_ : map_.size(); }
+
+    Price bestprice() const {
+        return dense_ ? priceof(best_) : map_.begin()->first;
+    }
+    Level& bestlevel() {
+        return dense_ ? levels_[best_] : map_.begin()->second;
+    }
+
+    // Append to the back of the node's price level, creating the level if needed.
+    template <class Node>
+    void push(Node* node) {
+        Price price = node->order_.getprice();
+        if (!dense_) {
+            map_[price].push_back(node);
+            return;
+        }
+        int idx = indexof(price);
+        levels_[idx].push_back(node);
+        setbit(idx);
+        if (best_ < 0 || better(idx, best_)) best_ = idx;
+    }
+
+    // Unlink a resting order and drop its level if that leaves it empty.
+    template <class Node>
+    void erase(Node* node) {
+        Price price = node->order_.getprice();
+        if (!dense_) {
+            auto it = map_.find(price);
+            it->second.erase(node);
+            if (it->second.empty()) map_.erase(it);
+            return;
+        }
+        int idx = indexof(price);
+        levels_[idx].erase(node);
+        if (levels_[idx].empty()) droplevel(idx);
+    }
+
+    // Existing level at a price that is known to be resting.
+    Level& levelat(Price price) {
+        return dense_ ? levels_[indexof(price)] : map_.find(price)->second;
+    }
+
+    // Level at a price, or nullptr if nothing rests there.
+    const Level* findlevel(Price price) const {
+        if (!dense_) {
+            auto it = map_.find(price);
+            return it == map_.end() ? nullptr : &it->second;
+        }
+        if (!accepts(price)) return nullptr;
+        const Level& level = levels_[indexof(price)];
+        return level.empty() ? nullptr : &level;
+    }
+
+    // Drop the best level once the match loop has emptied it.
+    void erasebest() {
+        if (!dense_) map_.erase(map_.begin());
+        else droplevel(best_);
+    }
+
+    // Visit non-empty levels best-first until f returns false.
+    template <class F>
+    void foreachlevel(F f) const {
+        if (!dense_) {
+            for (auto& [price, level] : map_)
+                if (!f(price, level)) return;
+            return;
+        }
+        for (int idx = best_; idx >= 0; idx = nextworse(idx))
+            if (!f(priceof(idx), levels_[idx])) return;
+    }
+
+private:
+    int indexof(Price price) const { return (int)((price - config_.baseprice) / config_.ticksize); }
+    Price priceof(int idx) const { return config_.baseprice + config_.ticksize * idx; }
+    bool better(int a, int b) const { return descending ? a > b : a < b; }
+
+    void setbit(int idx) {
+        int w = idx >> 6;
+        if (!(words_[w] >> (idx & 63) & 1)) ++occupied_;
+        words_[w] |= uint64_t(1) << (idx & 63);
+        summary_[w >> 6] |= uint64_t(1) << (w & 63);
+    }
+
+    void droplevel(int idx) {
+        int w = idx >> 6;
+        words_[w] &= ~(uint64_t(1) << (idx & 63));
+        --occupied_;
+        if (words_[w] == 0)
+            summary_[w >> 6] &= ~(uint64_t(1) << (w & 63));
+        if (idx == best_) best_ = nextworse(idx);
+    }
+
+    int nextworse(int idx) const { return descending ? prevset(idx) : nextset(idx); }
+
+    // Lowest occupied index > idx, or -1.
+    int nextset(int idx) const {
+        int w = idx >> 6;
+        uint64_t bits = (idx & 63) == 63 ? 0 : words_[w] & (~uint64_t(0) << ((idx & 63) + 1));
+        if (bits) return (w << 6) + __builtin_ctzll(bits);
+        int s = (w + 1) >> 6;
+        if (s >= (int)summary_.size()) return -1;
+        uint64_t sbits = ((w + 1) & 63) == 0 ? summary_[s] : summary_[s] & (~uint64_t(0) << ((w + 1) & 63));
+        while (!sbits) {
+            if (++s >= (int)summary_.size()) return -1;
+            sbits = summary_[s];
+        }
+        int nw = (s << 6) + __builtin_ctzll(sbits);
+        return (nw << 6) + __builtin_ctzll(words_[nw]);
+    }
+
+    // Highest occupied index < idx, or -1.
+    int prevset(int idx) const {
+        int w = idx >> 6;
+        uint64_t bits = words_[w] & ((uint64_t(1) << (idx & 63)) - 1);
+        if (bits) return (w << 6) + 63 - __builtin_clzll(bits);
+        if (w == 0) return -1;
+        int s = (w - 1) >> 6;
+        uint64_t sbits = summary_[s] & (~uint64_t(0) >> (63 - ((w - 1) & 63)));
+        while (!sbits) {
+            if (--s < 0) return -1;
+            sbits = summary_[s];
+        }
+        int nw = (s << 6) + 63 - __builtin_clzll(sbits);
+        return (nw << 6) + 63 - __builtin_clzll(words_[nw]);
+    }
+
+    ladderconfig config_;
+    bool dense_ = false;
+    map<Price, Level, Compare> map_;
+    vector<Level> levels_;
+    vector<uint64_t> words_;
+    vector<uint64_t> summary_;
+    int best_ = -1;
+    size_t occupied_ = 0;
+};
+
+#endif // PRICELADDER_H
@@ -0,0 +1,195 @@
+#ifndef RISK_H
+#define RISK_H
+
+#include "orderbook.h"
+
+// Pre-trade risk checks, run on every inbound message before it is queued to
+// the matcher. State is flat arrays indexed by account and book, so a check is
+// a handful of loads and compares with no lookups or allocation. An account is
+// whatever the caller risk-manages as one unit (FixApp uses one per session).
+//
+// Notional is price units times quantity (see Price::scale). Checks work it
+// out in 128 bits, so a huge price or quantity cannot wrap round and pass.
+// Not thread-safe: the caller serialises checks with the updates that come
+// back from the engine.
+
+enum class riskresult : uint8_t {
+    Ok,
+    Throttled,      // Message rate above the account's limit.
+    MaxOrderQty,
+    MaxNotional,    // Single order notional.
+    PriceBand,      // Too far from the book's reference price.
+    NoReference,    // Market order before the book has a reference price.
+    MaxOpenOrders,
+    MaxPosition,    // Position if every open order on this side filled.
+    MaxExposure,    // Open notional across the account.
+};
+
+inline const char* riskreason(riskresult r) {
+    switch (r) {
+    case riskresult::Ok: return "Ok";
+    case riskresult::Throttled: return "Message rate limit exceeded";
+    case riskresult::MaxOrderQty: return "Order quantity above limit";
+    case riskresult::MaxNotional: return "Order notional above limit";
+    case riskresult::PriceBand: return "Price outside band";
+    case riskresult::NoReference: return "No reference price for market order";
+    case riskresult::MaxOpenOrders: return "Too many open orders";
+    case riskresult::MaxPosition: return "Position limit exceeded";
+    case riskresult::MaxExposure: return "Exposure limit exceeded";
+    }
+    return "Unknown";
+}
+
+// Per-account limits. The defaults disable every check.
+struct risklimits {
+    static constexpr int64_t unlimited = numeric_limits<int64_t>::max() / 4;
+    Qty maxorderqty{ unlimited };
+    int64_t maxnotional = unlimited;        // Per order.
+    int64_t pricebandbps = 0;               // Around the reference price; 0 disables.
+    int64_t maxopenorders = unlimited;
+    Qty maxposition{ unlimited };           // Per book, long or short.
+    int64_t maxexposure = unlimited;        // Open notional, whole account.
+    int64_t maxmessagespersecond = 0;       // 0 disables the throttle.
+    int64_t burst = 1;                      // Messages allowed back to back.
+};
+
+class riskengine {
+public:
+    explicit riskengine(size_t books) : books_(books), reference_(books, 0) {}
+
+    // Register an account; returns its index. Allocates, so do it at session setup.
+    int addaccount(const risklimits& limits) {
+        accounts_.push_back(account{ limits });
+        accounts_.back().interval_ = limits.maxmessagespersecond > 0 ? 1000000000 / limits.maxmessagespersecond : 0;
+        positions_.resize(accounts_.size() * books_);
+        return (int)accounts_.size() - 1;
+    }
+    size_t accountcount() const { return accounts_.size(); }
+
+    // Book's reference price for the band check: the last trade, or whatever
+    // the caller seeds it with (e.g. the previous close).
+    void setreference(int book, Price price) { reference_[book] = price.value(); }
+    Price reference(int book) const { return Price(reference_[book]); }
+
+    // Message-rate throttle as a generic cell rate algorithm: each message
+    // pushes a theoretical arrival time forward by 1/rate, and a message is
+    // refused if that time runs more than burst intervals ahead of now.
+    bool admit(int acct, uint64_t nowns) {
+        account& a = accounts_[acct];
+        if (a.interval_ == 0) return true;
+        int64_t now = (int64_t)nowns;
+        int64_t tat = max(a.tat_, now);
+        if (tat - now > (a.limits_.burst - 1) * a.interval_) return false;
+        a.tat_ = tat + a.interval_;
+        return true;
+    }
+
+    // Checks for a new order. price is the limit, or Price::none() for a
+    // market order, which is valued at the reference price. All conditions
+    // are evaluated without branching and the first failure is reported.
+    riskresult checknew(int acct, int book, Side side, Price price, Qty qty, uint64_t nowns) {
+        if (!admit(acct, nowns)) return riskresult::Throttled;
+        const account& a = accounts_[acct];
+        const risklimits& l = a.limits_;
+        const bookposition& p = position(acct, book);
+        int64_t ref = reference_[book];
+        bool market = price == Price::none();
+        int64_t px = market ? ref : price.value();
+        int64_t q = qty.value();
+        wide notional = (wide)px * q;
+        wide worst = side == Side::Buy ? (wide)p.position_ + p.openbuy_ + q : (wide)p.opensell_ - p.position_ + q;
+        unsigned fail = 0;
+        fail |= unsigned(q > l.maxorderqty.value()) << (int)riskresult::MaxOrderQty;
+        fail |= unsigned(notional > l.maxnotional) << (int)riskresult::MaxNotional;
+        fail |= unsigned(!market && outsideband(px, ref, l.pricebandbps)) << (int)riskresult::PriceBand;
+        fail |= unsigned(market && ref == 0) << (int)riskresult::NoReference;
+        fail |= unsigned(a.openorders_ + 1 > l.maxopenorders) << (int)riskresult::MaxOpenOrders;
+        fail |= unsigned(worst > l.maxposition.value()) << (int)riskresult::MaxPosition;
+        fail |= unsigned(a.opennotional_ + notional > l.maxexposure) << (int)riskresult::MaxExposure;
+        return fail ? (riskresult)__builtin_ctz(fail) : riskresult::Ok;
+    }
+
+    // Checks for a cancel/replace from (oldprice, oldleaves) to (price, leaves).
+    // Only growth in quantity or notional counts against position and exposure.
+    riskresult checkreplace(int acct, int book, Side side, Price oldprice, Qty oldleaves,
+        Price price, Qty leaves, uint64_t nowns) {
+        if (!admit(acct, nowns)) return riskresult::Throttled;
+        const account& a = accounts_[acct];
+        const risklimits& l = a.limits_;
+        const bookposition& p = position(acct, book);
+        int64_t ref = reference_[book];
+        int64_t q = leaves.value();
+        wide grow = max<wide>((wide)q - oldleaves.value(), 0);
+        wide notional = (wide)price.value() * q;
+        wide growth = max<wide>(notional - (wide)oldprice.value() * oldleaves.value(), 0);
+        wide worst = side == Side::Buy ? (wide)p.position_ + p.openbuy_ + grow : (wide)p.opensell_ - p.position_ + grow;
+        unsigned fail = 0;
+        fail |= unsigned(q > l.maxorderqty.value()) << (int)riskresult::MaxOrderQty;
+        fail |= unsigned(notional > l.maxnotional) << (int)riskresult::MaxNotional;
+        fail |= unsigned(outsideband(price.value(), ref, l.pricebandbps)) << (int)riskresult::PriceBand;
+        fail |= unsigned(worst > l.maxposition.value()) << (int)riskresult::MaxPosition;
+        fail |= unsigned(a.opennotional_ + growth > l.maxexposure) << (int)riskresult::MaxExposure;
+        return fail ? (riskresult)__builtin_ctz(fail) : riskresult::Ok;
+    }
+
+    // Book-keeping as orders are accepted and report back. price is what the
+    // order was valued at in checknew/checkreplace.
+    void opened(int acct, int book, Side side, Price price, Qty qty) {
+        ++accounts_[acct].openorders_;
+        reserve(acct, book, side, price, qty);
+    }
+    void closed(int acct) { --accounts_[acct].openorders_; }
+
+    void reserve(int acct, int book, Side side, Price price, Qty qty) {
+        bookposition& p = position(acct, book);
+        (side == Side::Buy ? p.openbuy_ : p.opensell_) += qty.value();
+        accounts_[acct].opennotional_ += price.value() * qty.value();
+    }
+    void release(int acct, int book, Side side, Price price, Qty qty) { reserve(acct, book, side, price, Qty(-qty.value())); }
+
+    // An order of this account traded qty at execprice.
+    void fill(int acct, int book, Side side, Price price, Qty qty, Price execprice) {
+        release(acct, book, side, price, qty);
+        position(acct, book).position_ += side == Side::Buy ? qty.value() : -qty.value();
+        reference_[book] = execprice.value();
+    }
+
+    // Any trade in the book moves its reference price.
+    void trade(int book, Price execprice) { reference_[book] = execprice.value(); }
+
+    Qty positionof(int acct, int book) const { return Qty(position(acct, book).position_); }
+    int64_t exposureof(int acct) const { return accounts_[acct].opennotional_; }
+    int64_t openordersof(int acct) const { return accounts_[acct].openorders_; }
+
+private:
+    using wide = __int128;
+
+    // More than bps basis points from a known reference price.
+    static bool outsideband(int64_t px, int64_t ref, int64_t bps) {
+        wide off = (wide)px - ref;
+        return bps > 0 && ref > 0 && (off < 0 ? -off : off) * 10000 > (wide)ref * bps;
+    }
+
+    struct account {
+        risklimits limits_;
+        int64_t interval_ = 0;      // ns per message at the limit rate.
+        int64_t tat_ = 0;           // Throttle's theoretical arrival time.
+        int64_t openorders_ = 0;
+        int64_t opennotional_ = 0;
+    };
+    struct bookposition {
+        int64_t position_ = 0;      // Net filled quantity, long positive.
+        int64_t openbuy_ = 0;       // Open quantity on resting/in-flight orders.
+        int64_t opensell_ = 0;
+    };
+
+    bookposition& position(int acct, int book) { return positions_[(size_t)acct * books_ + book]; }
+    const bookposition& position(int acct, int book) const { return positions_[(size_t)acct * books_ + book]; }
+
+    size_t books_;
+    vector<account> accounts_;
+    vector<bookposition> positions_;    // accounts x books.
+    vector<int64_t> reference_;         // Price units, 0 until known.
+};
+
+#endif // RISK_H
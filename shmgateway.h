@@ -0,0 +1,409 @@
+#ifndef SHMGATEWAY_H
+#define SHMGATEWAY_H
+
+#include "orderbookmanager.h"
+#include "risk.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Native binary order entry for strategies on the same host. Each client gets
+// its own POSIX shared-memory segment holding two SPSC rings: requests in,
+// responses out. No sockets, no tag-value parsing, no syscalls on the hot path.
+//
+// Order IDs on the wire are the client's own; the gateway maps them to engine
+// IDs so clients cannot collide with each other or with the FIX path. Each
+// client is its own self-trade prevention owner and its own pre-trade risk
+// account, checked the same way as a FIX session.
+struct gwrequest {
+    uint8_t type_;        // commandtype
+    uint8_t ordertype_;
+    uint8_t side_;
+    uint8_t reserved_;
+    int32_t book_;
+    uint64_t id_;         // Client order ID.
+    int64_t price_;       // Engine price units.
+    int64_t quantity_;    // New total quantity for Modify.
+};
+
+struct gwresponse {
+    uint8_t type_;        // eventtype
+    uint8_t side_;
+    uint16_t reserved_;
+    int32_t book_;
+    uint64_t id_;         // Client order ID.
+    int64_t price_;
+    int64_t quantity_;    // As in execevent.
+};
+static_assert(sizeof(gwrequest) == 32, "gateway request layout");
+static_assert(sizeof(gwresponse) == 32, "gateway response layout");
+static_assert(atomic<uint64_t>::is_always_lock_free, "ring indices must be usable across processes");
+
+// SPSC ring living in shared memory; the object itself is a per-process view.
+// Same protocol as spscqueue, with the cached indices kept process-local.
+template <class T>
+class shmspsc {
+    static_assert(is_trivially_copyable_v<T>, "ring slots are copied by value");
+    struct header {
+        alignas(cachelinesize) atomic<uint64_t> head_;
+        alignas(cachelinesize) atomic<uint64_t> tail_;
+    };
+public:
+    static size_t bytes(size_t capacity) {
+        size_t n = sizeof(header) + capacity * sizeof(T);
+        return (n + cachelinesize - 1) / cachelinesize * cachelinesize;
+    }
+
+    shmspsc() = default;
+    // capacity must be a power of two. init is done once, by the creator.
+    shmspsc(void* base, size_t capacity, bool init)
+        : header_(static_cast<header*>(base)), slots_(reinterpret_cast<T*>(header_ + 1)), mask_(capacity - 1) {
+        if (init) {
+            new (header_) header;
+            header_->head_.store(0, memory_order_relaxed);
+            header_->tail_.store(0, memory_order_relaxed);
+        }
+        headcache_ = header_->head_.load(memory_order_acquire);
+        tailcache_ = header_->tail_.load(memory_order_acquire);
+    }
+
+    bool push(const T& item) {
+        uint64_t tail = header_->tail_.load(memory_order_relaxed);
+        if (tail - headcache_ > mask_) {
+            headcache_ = header_->head_.load(memory_order_acquire);
+            if (tail - headcache_ > mask_) return false;
+        }
+        slots_[tail & mask_] = item;
+        header_->tail_.store(tail + 1, memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        uint64_t head = header_->head_.load(memory_order_relaxed);
+        if (head == tailcache_) {
+            tailcache_ = header_->tail_.load(memory_order_acquire);
+            if (head == tailcache_) return false;
+        }
+        item = slots_[head & mask_];
+        header_->head_.store(head + 1, memory_order_release);
+        return true;
+    }
+
+private:
+    header* header_ = nullptr;
+    T* slots_ = nullptr;
+    uint64_t mask_ = 0;
+    uint64_t headcache_ = 0;
+    uint64_t tailcache_ = 0;
+};
+
+// One client's segment: a header, then the request ring, then the response ring.
+class gwchannel {
+    struct segmentheader {
+        char magic_[8];               // "OBGW2"
+        uint64_t capacity_;
+        atomic<uint32_t> ready_;      // Set by the engine once the rings are initialised.
+        atomic<uint32_t> connected_;  // Set by the client when it attaches.
+    };
+    static constexpr size_t headerbytes = (sizeof(segmentheader) + cachelinesize - 1) / cachelinesize * cachelinesize;
+public:
+    // Engine side: create (or recreate) the segment.
+    static unique_ptr<gwchannel> create(const string& name, size_t capacity) {
+        size_t n = 1;
+        while (n < capacity) n <<= 1;
+        ::shm_unlink(name.c_str());
+        int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0)
+            throw runtime_error("gwchannel: cannot create " + name);
+        size_t bytes = totalbytes(n);
+        if (::ftruncate(fd, (off_t)bytes) != 0) {
+            ::close(fd);
+            throw runtime_error("gwchannel: cannot size " + name);
+        }
+        auto ch = unique_ptr<gwchannel>(new gwchannel(name, fd, bytes, true));
+        ch->header_->capacity_ = n;
+        ch->attach(true);
+        memcpy(ch->header_->magic_, "OBGW2", 6);
+        ch->header_->ready_.store(1, memory_order_release);
+        return ch;
+    }
+
+    // Client side: attach to a segment the engine has created. Returns nullptr
+    // if it does not exist or is not initialised yet, so callers can retry.
+    static unique_ptr<gwchannel> open(const string& name) {
+        int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) return nullptr;
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || (size_t)st.st_size < headerbytes) {
+            ::close(fd);
+            return nullptr;
+        }
+        auto ch = unique_ptr<gwchannel>(new gwchannel(name, fd, (size_t)st.st_size, false));
+        if (!ch->header_->ready_.load(memory_order_acquire)) return nullptr;
+        if (memcmp(ch->header_->magic_, "OBGW2", 6) != 0 || ch->bytes_ != totalbytes(ch->header_->capacity_))
+            throw runtime_error("gwchannel: not an OBGW2 segment: " + name);
+        ch->attach(false);
+        ch->header_->connected_.store(1, memory_order_release);
+        return ch;
+    }
+
+    ~gwchannel() {
+        ::munmap(header_, bytes_);
+        if (owner_) ::shm_unlink(name_.c_str());
+    }
+    gwchannel(const gwchannel&) = delete;
+    gwchannel& operator=(const gwchannel&) = delete;
+
+    shmspsc<gwrequest>& requests() { return requests_; }
+    shmspsc<gwresponse>& responses() { return responses_; }
+    bool connected() const { return header_->connected_.load(memory_order_acquire) != 0; }
+
+private:
+    gwchannel(const string& name, int fd, size_t bytes, bool owner) : name_(name), bytes_(bytes), owner_(owner) {
+        void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+            throw runtime_error("gwchannel: mmap failed for " + name);
+        header_ = static_cast<segmentheader*>(p);
+    }
+
+    static size_t totalbytes(size_t capacity) {
+        return headerbytes + shmspsc<gwrequest>::bytes(capacity) + shmspsc<gwresponse>::bytes(capacity);
+    }
+
+    void attach(bool init) {
+        size_t n = header_->capacity_;
+        char* base = reinterpret_cast<char*>(header_) + headerbytes;
+        requests_ = shmspsc<gwrequest>(base, n, init);
+        responses_ = shmspsc<gwresponse>(base + shmspsc<gwrequest>::bytes(n), n, init);
+    }
+
+    string name_;
+    segmentheader* header_ = nullptr;
+    size_t bytes_ = 0;
+    bool owner_ = false;
+    shmspsc<gwrequest> requests_;
+    shmspsc<gwresponse> responses_;
+};
+
+// Client library: a thin wrapper a strategy process links against.
+class gwclient {
+public:
+    // Waits up to timeout for the engine to publish the segment.
+    explicit gwclient(const string& name, chrono::milliseconds timeout = chrono::seconds(5)) {
+        auto deadline = chrono::steady_clock::now() + timeout;
+        while (!(channel_ = gwchannel::open(name))) {
+            if (chrono::steady_clock::now() > deadline)
+                throw runtime_error("gwclient: no gateway segment " + name);
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    }
+
+    // False when the request ring is full.
+    bool send(const gwrequest& req) { return channel_->requests().push(req); }
+    bool poll(gwresponse& resp) { return channel_->responses().pop(resp); }
+
+private:
+    unique_ptr<gwchannel> channel_;
+};
+
+// Engine side. One thread polls every client's request ring, runs the client's
+// risk checks, translates client IDs and submits commands to the manager, then
+// routes the manager's execution events back to the owning client. That thread
+// owns the risk state, so it needs no lock. Because it drains the manager's
+// events, a process runs either this gateway or FixApp as the event consumer,
+// not both.
+class shmgateway {
+public:
+    // Engine order IDs are assigned from firstid upwards. Symbols must all be
+    // registered with books first.
+    explicit shmgateway(OrderbookManager& books, OrderId firstid = OrderId(uint64_t(1) << 48), size_t ringcapacity = 1 << 12)
+        : books_(books), nextid_(firstid), capacity_(ringcapacity), risk_(books.bookcount()) {
+        routes_.reserve(1 << 16);
+    }
+    ~shmgateway() { stop(); }
+    shmgateway(const shmgateway&) = delete;
+    shmgateway& operator=(const shmgateway&) = delete;
+
+    // Create the segment a client will attach to, with the client's risk
+    // limits. Call before start().
+    int addclient(const string& name, const risklimits& limits = {}) {
+        if (running_)
+            throw logic_error("shmgateway: clients must be added before start()");
+        clients_.push_back(make_unique<client>());
+        clients_.back()->channel_ = gwchannel::create(name, capacity_);
+        clients_.back()->account_ = risk_.addaccount(limits);
+        clients_.back()->ids_.reserve(1 << 12);
+        return (int)clients_.size() - 1;
+    }
+
+    // cpu >= 0 pins the gateway thread.
+    void start(int cpu = -1) {
+        if (running_.exchange(true)) return;
+        worker_ = thread([this, cpu] {
+#ifdef __linux__
+            if (cpu >= 0) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            }
+#endif
+            run();
+            });
+    }
+
+    void stop() {
+        if (!running_.exchange(false)) return;
+        worker_.join();
+    }
+
+    // Responses that had to wait for room in a client's ring.
+    uint64_t stalls() const { return stalls_.load(memory_order_relaxed); }
+
+private:
+    struct client {
+        unique_ptr<gwchannel> channel_;
+        unordered_map<uint64_t, OrderId> ids_;  // Client order ID -> engine order ID.
+        int account_;
+    };
+
+    // A live order placed through the gateway.
+    struct route {
+        int client_;
+        uint64_t clientid_;
+        int book_;
+        Side side_;
+        Qty quantity_;
+        Qty filled_;
+        Price riskprice_;   // Price the open quantity is valued at for risk.
+    };
+
+    void run() {
+        gwrequest req;
+        int idle = 0;
+        while (running_.load(memory_order_acquire)) {
+            bool busy = false;
+            for (size_t c = 0; c < clients_.size(); ++c)
+                for (int i = 0; i < 64 && clients_[c]->channel_->requests().pop(req); ++i) {
+                    handle((int)c, req);
+                    busy = true;
+                }
+            if (books_.pollevents([&](const execevent& ev) { dispatch(ev); }) > 0) busy = true;
+            if (busy) idle = 0;
+            else if (++idle < 1024) cpurelax();
+            else this_thread::yield();
+        }
+    }
+
+    // New orders and replaces must pass the client's risk checks; cancels
+    // only reduce risk and go straight through. A cancel or replace goes to
+    // the book and side the order was placed on.
+    void handle(int c, const gwrequest& req) {
+        client& cl = *clients_[c];
+        ordercommand cmd{ (commandtype)req.type_, (ordertype)req.ordertype_, (Side)req.side_,
+            req.book_, OrderId(), Price(req.price_), Qty(req.quantity_), (uint32_t)c + 1, 0 };
+        if (cmd.type_ == commandtype::New) {
+            cmd.id_ = nextid_;
+            if (cl.ids_.count(req.id_) || req.book_ < 0 || (size_t)req.book_ >= books_.bookcount()
+                || risk_.checknew(cl.account_, cmd.book_, cmd.side_, cmd.price_, cmd.quantity_, nowns()) != riskresult::Ok) {
+                reply(c, gwresponse{ (uint8_t)eventtype::Rejected, req.side_, 0, req.book_, req.id_, req.price_, req.quantity_ });
+                return;
+            }
+            Price valued = cmd.price_ == Price::none() ? risk_.reference(cmd.book_) : cmd.price_;
+            risk_.opened(cl.account_, cmd.book_, cmd.side_, valued, cmd.quantity_);
+            if (!books_.submit(cmd)) {
+                risk_.release(cl.account_, cmd.book_, cmd.side_, valued, cmd.quantity_);
+                risk_.closed(cl.account_);
+                reply(c, gwresponse{ (uint8_t)eventtype::Rejected, req.side_, 0, req.book_, req.id_, req.price_, req.quantity_ });
+                return;
+            }
+            nextid_ = OrderId(nextid_.value() + 1);
+            cl.ids_.emplace(req.id_, cmd.id_);
+            routes_.emplace(cmd.id_, route{ c, req.id_, cmd.book_, cmd.side_, cmd.quantity_, Qty(0), valued });
+            return;
+        }
+        auto it = cl.ids_.find(req.id_);
+        if (it != cl.ids_.end()) {
+            const route& r = routes_.at(it->second);
+            cmd.id_ = it->second;
+            cmd.book_ = r.book_;
+            cmd.side_ = r.side_;
+            // A stop replaced without a price stays valued as before.
+            Price price = cmd.price_ == Price::none() ? r.riskprice_ : cmd.price_;
+            if ((cmd.type_ != commandtype::Modify
+                    || risk_.checkreplace(cl.account_, r.book_, r.side_, r.riskprice_, r.quantity_ - r.filled_, price,
+                           cmd.quantity_ - r.filled_, nowns()) == riskresult::Ok)
+                && books_.submit(cmd))
+                return;
+        }
+        eventtype reject = cmd.type_ == commandtype::Cancel ? eventtype::CancelRejected : eventtype::ReplaceRejected;
+        reply(c, gwresponse{ (uint8_t)reject, req.side_, 0, req.book_, req.id_, req.price_, req.quantity_ });
+    }
+
+    // Events for orders that did not come through the gateway are ignored,
+    // except that any trade moves the book's risk reference price.
+    void dispatch(const execevent& ev) {
+        if (ev.type_ == eventtype::Fill) risk_.trade(ev.book_, ev.price_);
+        auto it = routes_.find(ev.id_);
+        if (it == routes_.end()) return;
+        route& r = it->second;
+        reply(r.client_, gwresponse{ (uint8_t)ev.type_, (uint8_t)ev.side_, 0, ev.book_, r.clientid_,
+            ev.price_.value(), ev.quantity_.value() });
+        int account = clients_[r.client_]->account_;
+        Qty open = r.quantity_ - r.filled_;
+        switch (ev.type_) {
+        case eventtype::Fill:
+            risk_.fill(account, r.book_, r.side_, r.riskprice_, ev.quantity_, ev.price_);
+            r.filled_ += ev.quantity_;
+            break;
+        case eventtype::Replaced:
+            risk_.release(account, r.book_, r.side_, r.riskprice_, open);
+            r.quantity_ = ev.quantity_;
+            if (ev.price_ != Price::none()) r.riskprice_ = ev.price_;
+            risk_.reserve(account, r.book_, r.side_, r.riskprice_, r.quantity_ - r.filled_);
+            break;
+        case eventtype::SelfTrade:
+            risk_.release(account, r.book_, r.side_, r.riskprice_, ev.quantity_);
+            r.quantity_ -= ev.quantity_;
+            break;
+        case eventtype::Rejected:
+        case eventtype::Cancelled:
+        case eventtype::Expired:
+            risk_.release(account, r.book_, r.side_, r.riskprice_, open);
+            r.quantity_ = r.filled_;
+            break;
+        default:
+            break;
+        }
+        if (r.filled_ >= r.quantity_) {
+            if (open > Qty(0)) risk_.closed(account);
+            clients_[r.client_]->ids_.erase(r.clientid_);
+            routes_.erase(it);
+        }
+    }
+
+    // Like the shard's emit(): never drop a response while running.
+    void reply(int c, const gwresponse& resp) {
+        auto& ring = clients_[c]->channel_->responses();
+        if (ring.push(resp)) return;
+        stalls_.fetch_add(1, memory_order_relaxed);
+        while (!ring.push(resp)) {
+            if (!running_.load(memory_order_acquire)) return;
+            cpurelax();
+        }
+    }
+
+    OrderbookManager& books_;
+    OrderId nextid_;
+    size_t capacity_;
+    vector<unique_ptr<client>> clients_;
+    unordered_map<OrderId, route> routes_;  // Engine order ID -> owner.
+    riskengine risk_;
+    atomic<bool> running_{ false };
+    atomic<uint64_t> stalls_{ 0 };
+    thread worker_;
+};
+
+#endif // SHMGATEWAY_H
@@ -0,0 +1,234 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "orderbook.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Binary snapshot of every resting order in one shard's books, taken after the
+// shard had applied seq_ commands. Orders are stored per book in priority
+// order (bids best-first, then asks, then dormant stops in trigger order, each
+// level front to back), so restoring them in file order rebuilds the same
+// queues. Each book also records its last trade price, which stops trigger on.
+struct snapshotheader {
+    char magic_[4];       // "OBS1"
+    uint32_t version_;
+    uint64_t seq_;        // Commands the shard had applied (its WAL position).
+    uint32_t books_;
+    uint32_t recordsize_;
+};
+
+struct snapshotbook {
+    int32_t book_;
+    uint32_t reserved_;
+    uint64_t orders_;     // snapshotorder records that follow.
+    int64_t lastprice_;   // Orderbook::lastprice().
+};
+
+struct snapshotorder {
+    uint64_t id_;
+    int64_t price_;
+    int64_t quantity_;    // Original quantity.
+    int64_t remaining_;
+    uint8_t side_;
+    uint8_t ordertype_;
+    uint8_t reserved_[2];
+    uint32_t owner_;
+    int64_t stop_;        // Stop price, or Price::none().
+    int64_t display_;     // Iceberg display quantity.
+    int64_t hidden_;      // Iceberg quantity behind the displayed slice.
+};
+static_assert(sizeof(snapshotheader) == 24, "snapshot header layout");
+static_assert(sizeof(snapshotbook) == 24, "snapshot book layout");
+static_assert(sizeof(snapshotorder) == 64, "snapshot order layout");
+
+inline constexpr uint32_t snapshotversion = 2;
+
+// Takes snapshots without pausing matching: the calling thread forks, and the
+// child writes its copy-on-write image of the books while the parent carries
+// on. The parent only pays for fork() itself (copying page tables). At most
+// one child runs at a time.
+//
+// The child must not allocate (another thread may have held the heap lock at
+// fork time), so it serialises through a buffer allocated up front and plain
+// write() calls, and leaves with _exit(). The file is written under a
+// temporary name, synced and renamed, so a crash never leaves a torn snapshot.
+class snapshotter {
+public:
+    explicit snapshotter(const string& path, size_t buffersize = 1 << 20)
+        : path_(path), tmppath_(path + ".tmp"), buffer_(buffersize) {}
+    ~snapshotter() { wait(); }
+    snapshotter(const snapshotter&) = delete;
+    snapshotter& operator=(const snapshotter&) = delete;
+
+    // Fork a child to snapshot books (indices into all) at position seq.
+    // Returns false if the previous snapshot is still being written or fork
+    // failed; the caller retries later.
+    bool take(uint64_t seq, const vector<int>& books, const vector<unique_ptr<Orderbook>>& all) {
+        if (busy()) return false;
+        auto start = chrono::steady_clock::now();
+        pid_t pid = ::fork();
+        if (pid < 0) return false;
+        if (pid == 0) _exit(writefile(seq, books, all) ? 0 : 1);
+        pausens_ = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        child_ = pid;
+        return true;
+    }
+
+    // Whether a snapshot child is still running; reaps it if it has finished.
+    bool busy() {
+        if (child_ <= 0) return false;
+        int status;
+        pid_t r = ::waitpid(child_, &status, WNOHANG);
+        if (r == 0) return true;
+        reap(r == child_ ? status : -1);
+        return false;
+    }
+
+    // Block until the running snapshot (if any) is on disk.
+    void wait() {
+        if (child_ <= 0) return;
+        int status;
+        pid_t r;
+        while ((r = ::waitpid(child_, &status, 0)) < 0 && errno == EINTR) {}
+        reap(r == child_ ? status : -1);
+    }
+
+    uint64_t written() const { return written_; }
+    uint64_t failed() const { return failed_; }
+    // How long the last fork() held up the calling thread.
+    uint64_t pausens() const { return pausens_; }
+
+private:
+    void reap(int status) {
+        if (status == 0) ++written_;
+        else ++failed_;
+        child_ = -1;
+    }
+
+    // Runs in the child.
+    bool writefile(uint64_t seq, const vector<int>& books, const vector<unique_ptr<Orderbook>>& all) {
+        fd_ = ::open(tmppath_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) return false;
+        used_ = 0;
+        ok_ = true;
+        snapshotheader header{ { 'O', 'B', 'S', '1' }, snapshotversion, seq, (uint32_t)books.size(), sizeof(snapshotorder) };
+        put(&header, sizeof(header));
+        for (int b : books) {
+            const Orderbook& ob = *all[b];
+            snapshotbook bh{ b, 0, ob.size(), ob.lastprice().value() };
+            put(&bh, sizeof(bh));
+            ob.foreachorder([&](const Order& o) {
+                snapshotorder rec{ o.getorderid().value(), o.getprice().value(), o.getini().value(),
+                    o.getrem().value(), (uint8_t)o.getside(), (uint8_t)o.getordertype(), {}, o.getowner(),
+                    o.getstopprice().value(), o.getdisplay().value(), o.gethidden().value() };
+                put(&rec, sizeof(rec));
+                });
+        }
+        flush();
+        ok_ = ok_ && ::fsync(fd_) == 0;
+        ::close(fd_);
+        return ok_ && ::rename(tmppath_.c_str(), path_.c_str()) == 0;
+    }
+
+    void put(const void* data, size_t size) {
+        if (used_ + size > buffer_.size()) flush();
+        memcpy(buffer_.data() + used_, data, size);
+        used_ += size;
+    }
+
+    void flush() {
+        const char* p = buffer_.data();
+        while (used_ > 0 && ok_) {
+            ssize_t n = ::write(fd_, p, used_);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                ok_ = false;
+                break;
+            }
+            p += n;
+            used_ -= (size_t)n;
+        }
+        used_ = 0;
+    }
+
+    string path_;
+    string tmppath_;
+    vector<char> buffer_;
+    pid_t child_ = -1;
+    uint64_t written_ = 0;
+    uint64_t failed_ = 0;
+    uint64_t pausens_ = 0;
+    // Child-side write state.
+    int fd_ = -1;
+    size_t used_ = 0;
+    bool ok_ = true;
+};
+
+// Read-only memory-mapped view of a snapshot file.
+class snapshotreader {
+public:
+    explicit snapshotreader(const string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw runtime_error("snapshotreader: cannot open " + path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(snapshotheader)) {
+            ::close(fd);
+            throw runtime_error("snapshotreader: truncated snapshot " + path);
+        }
+        size_ = (size_t)st.st_size;
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+            throw runtime_error("snapshotreader: mmap failed for " + path);
+        data_ = static_cast<const char*>(p);
+        if (memcmp(header().magic_, "OBS1", 4) != 0 || header().version_ != snapshotversion
+            || header().recordsize_ != sizeof(snapshotorder)) {
+            ::munmap(const_cast<char*>(data_), size_);
+            throw runtime_error("snapshotreader: not a version " + to_string(snapshotversion) + " snapshot: " + path);
+        }
+    }
+    ~snapshotreader() { ::munmap(const_cast<char*>(data_), size_); }
+    snapshotreader(const snapshotreader&) = delete;
+    snapshotreader& operator=(const snapshotreader&) = delete;
+
+    uint64_t seq() const { return header().seq_; }
+
+    // f(const snapshotbook&, const snapshotorder* begin, const snapshotorder* end) per book.
+    template <class F>
+    void foreachbook(F f) const {
+        size_t pos = sizeof(snapshotheader);
+        for (uint32_t i = 0; i < header().books_; ++i) {
+            if (size_ - pos < sizeof(snapshotbook))
+                throw runtime_error("snapshotreader: truncated snapshot");
+            const snapshotbook* bh = reinterpret_cast<const snapshotbook*>(data_ + pos);
+            pos += sizeof(snapshotbook);
+            if ((size_ - pos) / sizeof(snapshotorder) < bh->orders_)
+                throw runtime_error("snapshotreader: truncated snapshot");
+            const snapshotorder* begin = reinterpret_cast<const snapshotorder*>(data_ + pos);
+            pos += bh->orders_ * sizeof(snapshotorder);
+            f(*bh, begin, begin + bh->orders_);
+        }
+    }
+
+private:
+    const snapshotheader& header() const { return *reinterpret_cast<const snapshotheader*>(data_); }
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+inline Order toorder(const snapshotorder& rec) {
+    Order order((ordertype)rec.ordertype_, OrderId(rec.id_), (Side)rec.side_, Price(rec.price_), Qty(rec.quantity_), rec.owner_);
+    order.fill(Qty(rec.quantity_ - rec.remaining_));
+    order.setstopprice(Price(rec.stop_));
+    order.setdisplay(Qty(rec.display_));
+    order.sethidden(Qty(rec.hidden_));
+    return order;
+}
+
+#endif // SNAPSHOT_H
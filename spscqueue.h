@@ -0,0 +1,85 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+inline constexpr size_t cachelinesize = 64;
+
+// Spin-wait hint for polling loops.
+inline void cpurelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    this_thread::yield();
+#endif
+}
+
+// Bounded single-producer/single-consumer ring. Capacity is rounded up to a
+// power of two. Each side keeps a cached copy of the other side's index so the
+// shared cache line is only read when the ring looks full/empty.
+template <class T>
+class spscqueue {
+    static_assert(is_trivially_copyable_v<T>, "ring slots are copied by value");
+public:
+    explicit spscqueue(size_t capacity) {
+        size_t n = 1;
+        while (n < capacity) n <<= 1;
+        slots_.resize(n);
+        mask_ = n - 1;
+    }
+    spscqueue(const spscqueue&) = delete;
+    spscqueue& operator=(const spscqueue&) = delete;
+
+    // Producer side. Returns false when the ring is full.
+    bool push(const T& item) {
+        size_t tail = tail_.load(memory_order_relaxed);
+        if (tail - headcache_ > mask_) {
+            headcache_ = head_.load(memory_order_acquire);
+            if (tail - headcache_ > mask_) return false;
+        }
+        slots_[tail & mask_] = item;
+        tail_.store(tail + 1, memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false when the ring is empty.
+    bool pop(T& item) {
+        size_t head = head_.load(memory_order_relaxed);
+        if (head == tailcache_) {
+            tailcache_ = tail_.load(memory_order_acquire);
+            if (head == tailcache_) return false;
+        }
+        item = slots_[head & mask_];
+        head_.store(head + 1, memory_order_release);
+        return true;
+    }
+
+    // Consumer side: look at the oldest item without taking it, or nullptr
+    // when the ring is empty. popfront() then drops it.
+    const T* front() {
+        size_t head = head_.load(memory_order_relaxed);
+        if (head == tailcache_) {
+            tailcache_ = tail_.load(memory_order_acquire);
+            if (head == tailcache_) return nullptr;
+        }
+        return &slots_[head & mask_];
+    }
+    void popfront() { head_.store(head_.load(memory_order_relaxed) + 1, memory_order_release); }
+
+    // Approximate fill level; exact only when called from one of the two ends.
+    size_t size() const {
+        return tail_.load(memory_order_acquire) - head_.load(memory_order_acquire);
+    }
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    vector<T> slots_;
+    size_t mask_ = 0;
+    alignas(cachelinesize) atomic<size_t> head_{ 0 };
+    size_t tailcache_ = 0;
+    alignas(cachelinesize) atomic<size_t> tail_{ 0 };
+    size_t headcache_ = 0;
+};
+
+#endif // SPSCQUEUE_H
@@ -0,0 +1,34 @@
+// applycommands against one applycommand per command.
+#include "commandflow.h"
+
+namespace {
+
+// Map and dense books under every self-trade prevention mode; the batched
+// book gets the stream in random-sized chunks, including empty ones.
+TEST(BatchTest, SameEventsAndBookAsSequential) {
+    for (uint64_t seed = 1; seed <= 200; ++seed) {
+        SCOPED_TRACE("seed " + to_string(seed));
+        bool dense = seed % 2;
+        auto makebook = [&] {
+            auto ob = dense ? make_unique<Orderbook>(ladderconfig{ Price(900), Price(1), 300 }, 64) : make_unique<Orderbook>(64);
+            ob->setstpmode((stpmode)(seed / 2 % 5));
+            return ob;
+        };
+        unique_ptr<Orderbook> sequential = makebook(), batched = makebook();
+        vector<ordercommand> cmds = randomcommands(seed, 3000);
+        vector<execevent> expected, actual;
+        for (const ordercommand& cmd : cmds)
+            applycommand(*sequential, cmd, [&](const execevent& ev) { expected.push_back(ev); });
+        mt19937_64 rng(seed);
+        for (size_t i = 0; i < cmds.size();) {
+            size_t n = min<size_t>(cmds.size() - i, rng() % 70);
+            applycommands(*batched, &cmds[i], n, actual);
+            i += n;
+        }
+        ASSERT_EQ(actual, expected);
+        ASSERT_EQ(batched->size(), sequential->size());
+        ASSERT_EQ(depthof(*batched), depthof(*sequential));
+    }
+}
+
+} // namespace
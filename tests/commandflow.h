@@ -0,0 +1,103 @@
+#ifndef COMMANDFLOW_H
+#define COMMANDFLOW_H
+
+#include <gtest/gtest.h>
+#include "../ordercommand.h"
+
+// Random command streams for equivalence tests: every order type, stops and
+// icebergs, cancels and replaces of live, done and unknown orders, reused IDs
+// and a few owners so self-trade prevention has work to do. Prices stay within
+// 32 ticks of 1000; with outliers, one in fifty is 5000 ticks away, off any
+// ladder sized for the band.
+inline vector<ordercommand> randomcommands(uint64_t seed, size_t count, bool outliers = true) {
+    mt19937_64 rng(seed);
+    auto pick = [&](uint64_t n) { return rng() % n; };
+    auto price = [&] { return Price(1000 + (int64_t)pick(64) - 32 + (outliers && pick(50) == 0 ? 5000 : 0)); };
+    vector<ordercommand> cmds;
+    vector<OrderId> ids;
+    for (size_t i = 0; i < count; ++i) {
+        ordercommand c{ commandtype::New, ordertype::Limit, pick(2) ? Side::Buy : Side::Sell, 0, OrderId(i + 1),
+            price(), Qty(1 + pick(20)) };
+        int roll = (int)pick(10);
+        if (roll < 5 || ids.empty()) {
+            if (pick(3) == 0) c.ordertype_ = (ordertype)pick(6);
+            if (pick(20) == 0 && !ids.empty()) c.id_ = ids[pick(ids.size())];
+            c.owner_ = (uint32_t)pick(4);
+            if (c.ordertype_ == ordertype::Market || c.ordertype_ == ordertype::Stop) c.price_ = Price::none();
+            if (c.ordertype_ == ordertype::Stop || c.ordertype_ == ordertype::StopLimit) c.stop_ = price();
+            if ((c.ordertype_ == ordertype::Limit || c.ordertype_ == ordertype::StopLimit) && pick(5) == 0)
+                c.display_ = Qty(1 + pick(5));
+            ids.push_back(c.id_);
+        }
+        else {
+            c.type_ = roll < 8 ? commandtype::Cancel : commandtype::Modify;
+            c.id_ = pick(10) == 0 ? OrderId(count + i + 1) : ids[pick(ids.size())];
+        }
+        cmds.push_back(c);
+    }
+    return cmds;
+}
+
+inline bool operator==(const execevent& a, const execevent& b) {
+    return a.type_ == b.type_ && a.side_ == b.side_ && a.book_ == b.book_ && a.id_ == b.id_
+        && a.price_ == b.price_ && a.quantity_ == b.quantity_;
+}
+
+inline ostream& operator<<(ostream& os, const execevent& ev) {
+    return os << "{type " << (int)ev.type_ << " side " << (int)ev.side_ << " id " << ev.id_ << " price "
+              << ev.price_ << " qty " << ev.quantity_ << "}";
+}
+
+// A book's aggregated levels as "bids | asks | ", best first, each level
+// price (in price units) x quantity / orders.
+inline string depthof(const Orderbook& ob) {
+    AggregatedOrderbook info = ob.getorderinfo();
+    ostringstream os;
+    for (const Levelinfos* side : { &info.getbids(), &info.getasks() }) {
+        for (const Levelinfo& level : *side) os << level.price.value() << 'x' << level.quantity << '/' << level.orders << ' ';
+        os << "| ";
+    }
+    return os.str();
+}
+
+// Fixture for tests run against both book backends: the map (false) and a
+// dense ladder (true) covering prices 90 to 119. Instantiate a suite
+// derived from it with INSTANTIATE_BOOK_TEST_SUITE.
+class BookTest : public testing::TestWithParam<bool> {
+protected:
+    BookTest() : book_(newbook()) {}
+
+    unique_ptr<Orderbook> newbook() const {
+        return GetParam() ? make_unique<Orderbook>(ladderconfig{ Price(90), Price(1), 30 }, 64) : make_unique<Orderbook>(64);
+    }
+
+    // The events applycommand reports for cmd.
+    vector<execevent> apply(const ordercommand& cmd) {
+        vector<execevent> events;
+        applycommand(*book_, cmd, [&](const execevent& ev) { events.push_back(ev); });
+        return events;
+    }
+
+    static execevent event(eventtype type, uint64_t id, Side side, Price price, int64_t qty) {
+        return execevent{ type, side, 0, OrderId(id), price, Qty(qty) };
+    }
+    // Buy fill then sell fill, as applycommand reports a trade.
+    static void trade(vector<execevent>& events, uint64_t bid, uint64_t ask, int64_t price, int64_t qty) {
+        events.push_back(event(eventtype::Fill, bid, Side::Buy, Price(price), qty));
+        events.push_back(event(eventtype::Fill, ask, Side::Sell, Price(price), qty));
+    }
+
+    // Open quantity of a live order, 0 once it is gone.
+    Qty remaining(uint64_t id) const {
+        optional<Order> order = book_->findorder(OrderId(id));
+        return order ? order->getrem() : Qty(0);
+    }
+
+    unique_ptr<Orderbook> book_;
+};
+
+#define INSTANTIATE_BOOK_TEST_SUITE(suite) \
+    INSTANTIATE_TEST_SUITE_P(Books, suite, testing::Bool(), \
+        [](const testing::TestParamInfo<bool>& info) { return info.param ? "Dense" : "Map"; })
+
+#endif // COMMANDFLOW_H
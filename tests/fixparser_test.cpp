@@ -0,0 +1,336 @@
+// parsenewordersingle against a reference decoder that splits the message
+// into string fields first, on well-formed, truncated and corrupted messages.
+#include <gtest/gtest.h>
+#include "fixparser.h"
+
+namespace {
+
+constexpr char soh = '\x01';
+
+string withtrailer(const string& body) {
+    string msg = "8=FIX.4.2\x01" "9=" + to_string(body.size()) + "\x01" + body;
+    unsigned sum = 0;
+    for (unsigned char c : msg) sum += c;
+    char trailer[8];
+    snprintf(trailer, sizeof(trailer), "10=%03u\x01", sum & 0xff);
+    return msg + trailer;
+}
+
+struct decoded {
+    string clordid, symbol;
+    Side side = Side::Buy;
+    ordertype type = ordertype::Limit;
+    Price price = Price::none(), stop = Price::none();
+    Qty quantity{ 0 }, display{ 0 };
+    size_t length = 0;
+};
+
+bool alldigits(const string& s) { return all_of(s.begin(), s.end(), [](char c) { return c >= '0' && c <= '9'; }); }
+
+// Unsigned decimal of 1 to 18 digits, no larger than max.
+bool refuint(const string& text, int64_t max, int64_t& out) {
+    if (text.empty() || text.size() > 18 || !alldigits(text) || stoll(text) > max) return false;
+    out = stoll(text);
+    return true;
+}
+
+bool refquantity(const string& text, Qty& out) {
+    size_t dot = text.find('.');
+    string fraction = dot == string::npos ? "" : text.substr(dot + 1);
+    int64_t v;
+    if (fraction.find_first_not_of('0') != string::npos || !refuint(text.substr(0, dot), LLONG_MAX, v) || v <= 0) return false;
+    out = Qty(v);
+    return true;
+}
+
+fixparsestatus refprice(const string& text, Price& out) {
+    bool negative = !text.empty() && text[0] == '-';
+    string digits = text.substr(negative);
+    size_t dot = digits.find('.');
+    string whole = digits.substr(0, dot);
+    if (whole.empty() || whole.size() > (size_t)(18 - Price::decimals) || !alldigits(whole)) return fixparsestatus::BadValue;
+    string fraction;
+    if (dot != string::npos) {
+        fraction = digits.substr(dot + 1);
+        if (fraction.empty()) return fixparsestatus::BadValue;
+    }
+    string kept = fraction.substr(0, min<size_t>(fraction.size(), Price::decimals));
+    if (!alldigits(kept)) return fixparsestatus::BadValue;
+    kept.resize(Price::decimals, '0');
+    for (size_t i = Price::decimals; i < fraction.size(); ++i) {
+        if (fraction[i] == '0') continue;
+        return isdigit((unsigned char)fraction[i]) ? fixparsestatus::OffTick : fixparsestatus::BadValue;
+    }
+    int64_t scaled = stoll(whole + kept);
+    out = Price(negative ? -scaled : scaled);
+    return fixparsestatus::Ok;
+}
+
+// Framing first, then the body's fields in order: the first bad value is
+// reported, but the fields after it are still decoded. Then required fields.
+fixparsestatus refdecode(const string& msg, decoded& out) {
+    if (msg.size() < 2) return fixparsestatus::Incomplete;
+    if (msg.compare(0, 2, "8=") != 0) return fixparsestatus::BadFraming;
+    size_t begin = msg.find(soh, 2);
+    if (begin == string::npos) return fixparsestatus::Incomplete;
+    size_t lengthat = begin + 1;
+    if (msg.size() - lengthat < 2) return fixparsestatus::Incomplete;
+    if (msg.compare(lengthat, 2, "9=") != 0) return fixparsestatus::BadFraming;
+    size_t lengthend = msg.find(soh, lengthat + 2);
+    if (lengthend == string::npos) return fixparsestatus::Incomplete;
+    int64_t bodylength;
+    if (!refuint(msg.substr(lengthat + 2, lengthend - lengthat - 2), 1 << 20, bodylength)) return fixparsestatus::BadFraming;
+    size_t bodyat = lengthend + 1;
+    if (msg.size() - bodyat < (size_t)bodylength + 7) return fixparsestatus::Incomplete;
+    string body = msg.substr(bodyat, bodylength);
+    string trailer = msg.substr(bodyat + bodylength, 7);
+    if (trailer.compare(0, 3, "10=") != 0 || trailer[6] != soh || !alldigits(trailer.substr(3, 3)))
+        return fixparsestatus::BadFraming;
+    unsigned sum = 0;
+    for (size_t i = 0; i < bodyat + bodylength; ++i) sum += (unsigned char)msg[i];
+    if ((int)(sum & 0xff) != stoi(trailer.substr(3, 3))) return fixparsestatus::BadChecksum;
+    out.length = bodyat + bodylength + 7;
+
+    if (body.size() < 4 || body.compare(0, 3, "35=") != 0) return fixparsestatus::BadFraming;
+    size_t typeend = min(body.find(soh), body.size());
+    if (body.substr(3, typeend - 3) != "D") return fixparsestatus::NotNewOrder;
+
+    set<int> seen;
+    char ordtype = '2', timeinforce = '0';
+    fixparsestatus invalid = fixparsestatus::Ok;
+    for (size_t at = typeend + 1; at < body.size();) {
+        size_t eq = body.find('=', at);
+        if (eq == string::npos) return fixparsestatus::BadFraming;
+        string tagtext = body.substr(at, eq - at);
+        tagtext.erase(0, min(tagtext.find_first_not_of('0'), tagtext.size()));
+        if (!alldigits(tagtext) || tagtext.size() > 6) return fixparsestatus::BadFraming;
+        size_t end = body.find(soh, eq + 1);
+        if (end == string::npos) return fixparsestatus::BadFraming;
+        int tag = tagtext.empty() ? 0 : stoi(tagtext);
+        string value = body.substr(eq + 1, end - eq - 1);
+        at = end + 1;
+        fixparsestatus st = fixparsestatus::Ok;
+        switch (tag) {
+        case 11:
+        case 55:
+            if (value.empty()) st = fixparsestatus::BadValue;
+            else (tag == 11 ? out.clordid : out.symbol) = value;
+            break;
+        case 54:
+            if (value != "1" && value != "2") st = fixparsestatus::BadValue;
+            else out.side = value == "1" ? Side::Buy : Side::Sell;
+            break;
+        case 38:
+            if (!refquantity(value, out.quantity)) st = fixparsestatus::BadValue;
+            break;
+        case 111:
+            if (!refquantity(value, out.display)) st = fixparsestatus::BadValue;
+            break;
+        case 44:
+        case 99:
+            st = refprice(value, tag == 44 ? out.price : out.stop);
+            break;
+        case 40:
+            if (value.size() != 1 || value[0] < '1' || value[0] > '4') st = fixparsestatus::BadValue;
+            else ordtype = value[0];
+            break;
+        case 59:
+            if (value.size() == 1) timeinforce = value[0];
+            continue;
+        default:
+            continue;
+        }
+        if (st == fixparsestatus::Ok) seen.insert(tag);
+        else if (invalid == fixparsestatus::Ok) invalid = st;
+    }
+    if (invalid != fixparsestatus::Ok) return invalid;
+    bool nolimit = ordtype == '1' || ordtype == '3';
+    for (int tag : { 11, 55, 54, 38 })
+        if (!seen.count(tag)) return fixparsestatus::MissingField;
+    if (!nolimit && !seen.count(44)) return fixparsestatus::MissingField;
+    if ((ordtype == '3' || ordtype == '4') && !seen.count(99)) return fixparsestatus::MissingField;
+    if (nolimit) out.price = Price::none();
+    out.type = ordtype == '1' ? ordertype::Market : ordtype == '3' ? ordertype::Stop : ordtype == '4' ? ordertype::StopLimit
+        : timeinforce == '3' ? ordertype::fillandkill : timeinforce == '4' ? ordertype::fillorkill : ordertype::Limit;
+    return fixparsestatus::Ok;
+}
+
+// Parse msg from an exactly-sized heap buffer, so a read past the end shows
+// up under a sanitizer, and compare with the reference.
+void expectsame(const string& msg) {
+    SCOPED_TRACE(msg);
+    unique_ptr<char[]> buffer(new char[max<size_t>(msg.size(), 1)]);
+    memcpy(buffer.get(), msg.data(), msg.size());
+    fixneworder order;
+    fixparsestatus st = parsenewordersingle(buffer.get(), msg.size(), order);
+    decoded ref;
+    ASSERT_EQ((int)st, (int)refdecode(msg, ref));
+    // A refused order is rejected back with its ClOrdID, symbol and side.
+    if (st != fixparsestatus::Ok && st != fixparsestatus::BadValue && st != fixparsestatus::OffTick
+        && st != fixparsestatus::MissingField)
+        return;
+    EXPECT_EQ(order.clordid(), ref.clordid);
+    EXPECT_EQ(order.symbol(), ref.symbol);
+    EXPECT_EQ(order.side_, ref.side);
+    if (st != fixparsestatus::Ok) return;
+    EXPECT_EQ(order.ordertype_, ref.type);
+    EXPECT_EQ(order.price_, ref.price);
+    EXPECT_EQ(order.quantity_, ref.quantity);
+    EXPECT_EQ(order.stop_, ref.stop);
+    EXPECT_EQ(order.display_, ref.display);
+    EXPECT_EQ(order.length_, ref.length);
+}
+
+// Field values, mostly valid, some malformed in the ways clients get wrong.
+struct messagegen {
+    explicit messagegen(uint64_t seed) : rng_(seed) {}
+
+    size_t pick(size_t n) { return rng_() % n; }
+    string oneof(initializer_list<const char*> values) { return *(values.begin() + pick(values.size())); }
+
+    string text(size_t maxlength) {
+        static const char chars[] = "ABCXYZabcxyz0123456789-_.:=/ ";
+        string s(pick(maxlength) + 1, ' ');
+        for (char& c : s) c = chars[pick(sizeof(chars) - 1)];
+        return s;
+    }
+    string price() {
+        if (pick(20) == 0) return oneof({ "", "-", ".5", "1.", "1e3", "12a", "1.2.3", "99999999999999999", "0.00001", "1.000000000" });
+        string s = (pick(10) == 0 ? "-" : "") + to_string(pick(200000));
+        int decimals = (int)pick(7);
+        if (decimals) {
+            s += '.';
+            for (int i = 0; i < decimals; ++i) s += (char)('0' + (i >= Price::decimals && pick(2) ? 0 : pick(10)));
+        }
+        return s;
+    }
+    string quantity() {
+        if (pick(20) == 0) return oneof({ "", "0", "-5", "1.5", "10.", "10.000", "abc", "1234567890123456789" });
+        return to_string(pick(100000) + 1) + (pick(5) == 0 ? ".00" : "");
+    }
+
+    // A NewOrderSingle body with its fields in random order among a few
+    // header and unknown tags; some are left out or repeated.
+    string body() {
+        vector<string> fields = { "49=CLIENT", "56=ENGINE", "34=" + to_string(pick(100000)), "52=20260101-09:30:00.123",
+            "11=" + text(47), "55=" + text(8), "54=" + (pick(20) ? oneof({ "1", "2" }) : oneof({ "", "3", "12" })),
+            "38=" + quantity() };
+        string ordtype = pick(10) == 0 ? oneof({ "", "0", "5", "P", "22" }) : oneof({ "1", "2", "3", "4" });
+        if (pick(4)) fields.push_back("40=" + ordtype);
+        if (pick(4)) fields.push_back("44=" + price());
+        if (pick(3) == 0 || ordtype == "3" || ordtype == "4") fields.push_back("99=" + price());
+        if (pick(4) == 0) fields.push_back("111=" + quantity());
+        if (pick(3) == 0) fields.push_back("59=" + oneof({ "0", "1", "3", "4", "33", "" }));
+        if (pick(5) == 0) fields.push_back(to_string(pick(1000000)) + "=" + text(10));
+        shuffle(fields.begin(), fields.end(), rng_);
+        if (pick(10) == 0) fields.erase(fields.begin() + pick(fields.size()));
+        if (pick(10) == 0) fields.push_back(fields[pick(fields.size())]);
+        string body = pick(50) ? "35=D" : oneof({ "35=8", "35=DD", "35=", "36=D" });
+        for (const string& f : fields) body += soh + f;
+        return body + soh;
+    }
+
+    mt19937_64 rng_;
+};
+
+TEST(FixParserTest, KnownMessages) {
+    fixneworder order;
+    string msg = withtrailer("35=D\x01" "11=ORD-1\x01" "55=AAPL\x01" "54=2\x01" "38=100\x01" "44=187.25\x01" "59=3\x01");
+    ASSERT_EQ(parsenewordersingle(msg.data(), msg.size(), order), fixparsestatus::Ok);
+    EXPECT_EQ(order.clordid(), "ORD-1");
+    EXPECT_EQ(order.symbol(), "AAPL");
+    EXPECT_EQ(order.side_, Side::Sell);
+    EXPECT_EQ(order.ordertype_, ordertype::fillandkill);
+    EXPECT_EQ(order.price_, Price::fromdouble(187.25));
+    EXPECT_EQ(order.quantity_, Qty(100));
+    EXPECT_EQ(order.length_, msg.size());
+
+    msg = withtrailer("35=D\x01" "11=2\x01" "55=X\x01" "54=1\x01" "38=10\x01" "40=1\x01" "59=4\x01");
+    ASSERT_EQ(parsenewordersingle(msg.data(), msg.size(), order), fixparsestatus::Ok);
+    EXPECT_EQ(order.ordertype_, ordertype::Market);
+    EXPECT_EQ(order.price_, Price::none());
+    msg = withtrailer("35=D\x01" "11=3\x01" "55=X\x01" "54=1\x01" "38=10\x01" "44=10\x01" "59=4\x01");
+    ASSERT_EQ(parsenewordersingle(msg.data(), msg.size(), order), fixparsestatus::Ok);
+    EXPECT_EQ(order.ordertype_, ordertype::fillorkill);
+    msg = withtrailer("35=D\x01" "11=4\x01" "55=X\x01" "54=1\x01" "38=10\x01" "40=4\x01" "44=10\x01" "99=9.5\x01" "111=2\x01");
+    ASSERT_EQ(parsenewordersingle(msg.data(), msg.size(), order), fixparsestatus::Ok);
+    EXPECT_EQ(order.ordertype_, ordertype::StopLimit);
+    EXPECT_EQ(order.stop_, Price::fromdouble(9.5));
+    EXPECT_EQ(order.display_, Qty(2));
+
+    // The fields after a bad value are still read, for the reject.
+    msg = withtrailer("35=D\x01" "11=1\x01" "44=10.000001\x01" "55=X\x01" "54=2\x01" "38=10\x01");
+    EXPECT_EQ(parsenewordersingle(msg.data(), msg.size(), order), fixparsestatus::OffTick);
+    EXPECT_EQ(order.clordid(), "1");
+    EXPECT_EQ(order.symbol(), "X");
+    EXPECT_EQ(order.side_, Side::Sell);
+    msg = withtrailer("35=D\x01" "11=\x01" "55=X\x01" "54=1\x01" "38=10\x01" "44=10\x01");
+    EXPECT_EQ(parsenewordersingle(msg.data(), msg.size(), order), fixparsestatus::BadValue);
+    msg = withtrailer("35=D\x01" "11=1\x01" "55=X\x01" "54=1\x01" "38=10\x01");
+    EXPECT_EQ(parsenewordersingle(msg.data(), msg.size(), order), fixparsestatus::MissingField);
+    msg = withtrailer("35=F\x01" "11=1\x01");
+    EXPECT_EQ(parsenewordersingle(msg.data(), msg.size(), order), fixparsestatus::NotNewOrder);
+    EXPECT_EQ(parsenewordersingle(msg.data(), msg.size() - 1, order), fixparsestatus::Incomplete);
+    msg[msg.size() - 2] ^= 1;
+    EXPECT_EQ(parsenewordersingle(msg.data(), msg.size(), order), fixparsestatus::BadChecksum);
+}
+
+// The QuickFIX path's Price doubles: whole price units convert, anything
+// finer is refused rather than rounded.
+TEST(FixParserTest, DoublePricesMustBeWholeUnits) {
+    Price p;
+    EXPECT_TRUE(Price::fromdoubleexact(187.25, p));
+    EXPECT_EQ(p, Price(18725 * Price::scale / 100));
+    EXPECT_TRUE(Price::fromdoubleexact(100.1, p));
+    EXPECT_EQ(p, Price(1001 * Price::scale / 10));
+    EXPECT_TRUE(Price::fromdoubleexact(-2.5, p));
+    EXPECT_EQ(p, Price(-25 * Price::scale / 10));
+    EXPECT_TRUE(Price::fromdoubleexact(1.0 / Price::scale, p));
+    EXPECT_EQ(p, Price(1));
+    EXPECT_FALSE(Price::fromdoubleexact(10 + 0.5 / Price::scale, p));
+    EXPECT_FALSE(Price::fromdoubleexact(0.3 / Price::scale, p));
+    EXPECT_FALSE(Price::fromdoubleexact(1e300, p));
+    EXPECT_FALSE(Price::fromdoubleexact(numeric_limits<double>::quiet_NaN(), p));
+}
+
+TEST(FixParserTest, RandomMessagesMatchReference) {
+    messagegen gen(1);
+    for (int i = 0; i < 100000; ++i) {
+        string msg = withtrailer(gen.body());
+        expectsame(msg);
+        if (HasFatalFailure()) return;
+    }
+}
+
+// Truncated, overlong and byte-corrupted messages; the checksum is fixed up
+// for some so the corruption reaches the body's fields.
+TEST(FixParserTest, CorruptedMessagesMatchReference) {
+    messagegen gen(2);
+    for (int i = 0; i < 100000; ++i) {
+        string body = gen.body();
+        string msg = withtrailer(body);
+        switch (gen.pick(5)) {
+        case 0:
+            msg.resize(gen.pick(msg.size()));
+            break;
+        case 1:
+            msg += withtrailer(gen.body());
+            break;
+        case 2:
+            msg[gen.pick(msg.size())] = (char)gen.pick(256);
+            break;
+        case 3:
+            body[gen.pick(body.size())] = gen.pick(2) ? soh : (char)gen.pick(256);
+            msg = withtrailer(body);
+            break;
+        default:
+            body.insert(gen.pick(body.size() + 1), gen.text(4));
+            msg = withtrailer(body);
+            break;
+        }
+        expectsame(msg);
+        if (HasFatalFailure()) return;
+    }
+}
+
+} // namespace
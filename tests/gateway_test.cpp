@@ -0,0 +1,59 @@
+// Shared-memory gateway: each client's orders go through its risk account.
+#include <gtest/gtest.h>
+#include "shmgateway.h"
+
+namespace {
+
+class GatewayTest : public testing::Test {
+protected:
+    GatewayTest() : books_(1) { books_.addsymbol("S"); }
+
+    void start(const risklimits& limits) {
+        gateway_ = make_unique<shmgateway>(books_);
+        name_ = "/gateway_test." + to_string(getpid());
+        gateway_->addclient(name_, limits);
+        books_.start();
+        gateway_->start();
+        client_ = make_unique<gwclient>(name_);
+    }
+    ~GatewayTest() override {
+        if (gateway_) gateway_->stop();
+        books_.stop();
+    }
+
+    // Send a request and wait for the response that settles it.
+    eventtype send(commandtype type, uint64_t id, Side side, int64_t price, int64_t qty) {
+        gwrequest req{ (uint8_t)type, (uint8_t)ordertype::Limit, (uint8_t)side, 0, 0, id, price, qty };
+        EXPECT_TRUE(client_->send(req));
+        gwresponse resp;
+        auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+        while (chrono::steady_clock::now() < deadline) {
+            if (client_->poll(resp)) return (eventtype)resp.type_;
+            this_thread::yield();
+        }
+        ADD_FAILURE() << "no response for order " << id;
+        return eventtype::Rejected;
+    }
+
+    OrderbookManager books_;
+    unique_ptr<shmgateway> gateway_;
+    string name_;
+    unique_ptr<gwclient> client_;
+};
+
+TEST_F(GatewayTest, OrdersAndReplacesAreRiskChecked) {
+    risklimits limits;
+    limits.maxorderqty = Qty(10);
+    limits.maxopenorders = 1;
+    start(limits);
+    EXPECT_EQ(send(commandtype::New, 1, Side::Buy, 100, 11), eventtype::Rejected);
+    EXPECT_EQ(send(commandtype::New, 1, Side::Buy, 100, 10), eventtype::New);
+    EXPECT_EQ(send(commandtype::New, 2, Side::Buy, 99, 1), eventtype::Rejected);
+    EXPECT_EQ(send(commandtype::Modify, 1, Side::Buy, 100, 11), eventtype::ReplaceRejected);
+    EXPECT_EQ(send(commandtype::Modify, 1, Side::Buy, 100, 5), eventtype::Replaced);
+    // Once the order is cancelled its open-order slot is free again.
+    EXPECT_EQ(send(commandtype::Cancel, 1, Side::Buy, 0, 0), eventtype::Cancelled);
+    EXPECT_EQ(send(commandtype::New, 2, Side::Buy, 99, 1), eventtype::New);
+}
+
+} // namespace
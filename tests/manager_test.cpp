@@ -0,0 +1,98 @@
+// OrderbookManager: shards, event rings and the recovery WAL.
+#include <gtest/gtest.h>
+#include "orderbookmanager.h"
+
+namespace {
+
+ordercommand neworder(uint64_t id, Side side, ordertype type, Price price, int64_t qty) {
+    return ordercommand{ commandtype::New, type, side, 0, OrderId(id), price, Qty(qty) };
+}
+
+// A scratch directory removed with everything in it when the test ends.
+struct scratchdir {
+    scratchdir() : path_(filesystem::temp_directory_path() / ("manager_test." + to_string(getpid()))) {
+        filesystem::create_directories(path_);
+    }
+    ~scratchdir() { filesystem::remove_all(path_); }
+    filesystem::path path_;
+};
+
+// Poll until count events arrived or a few seconds have passed.
+vector<execevent> pollfor(OrderbookManager& m, size_t count) {
+    vector<execevent> events;
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+    while (events.size() < count && chrono::steady_clock::now() < deadline)
+        if (m.pollevents([&](const execevent& ev) { events.push_back(ev); }) == 0) this_thread::yield();
+    return events;
+}
+
+// Priced orders and price-changing modifies need a positive price on the
+// tick; stops need a positive stop price too.
+TEST(ManagerTest, ValidateRejectsNonPositivePrices) {
+    OrderbookManager m(1);
+    instrumentspec spec;
+    spec.ticksize = Price(5);
+    m.addsymbol("S", {}, 0, spec);
+    for (ordertype type : { ordertype::Limit, ordertype::fillandkill, ordertype::fillorkill }) {
+        SCOPED_TRACE((int)type);
+        EXPECT_TRUE(m.validate(neworder(1, Side::Buy, type, Price(5), 1)));
+        EXPECT_FALSE(m.validate(neworder(1, Side::Buy, type, Price(7), 1)));
+        EXPECT_FALSE(m.validate(neworder(1, Side::Buy, type, Price(0), 1)));
+        EXPECT_FALSE(m.validate(neworder(1, Side::Buy, type, Price(-5), 1)));
+        EXPECT_FALSE(m.validate(neworder(1, Side::Buy, type, Price::none(), 1)));
+    }
+    EXPECT_TRUE(m.validate(neworder(1, Side::Buy, ordertype::Market, Price::none(), 1)));
+
+    ordercommand stop = neworder(1, Side::Sell, ordertype::StopLimit, Price(5), 1);
+    stop.stop_ = Price(10);
+    EXPECT_TRUE(m.validate(stop));
+    stop.stop_ = Price(-10);
+    EXPECT_FALSE(m.validate(stop));
+    stop.stop_ = Price(10);
+    stop.price_ = Price(-5);
+    EXPECT_FALSE(m.validate(stop));
+    stop.ordertype_ = ordertype::Stop;
+    stop.price_ = Price::none();
+    stop.stop_ = Price(0);
+    EXPECT_FALSE(m.validate(stop));
+
+    ordercommand modify{ commandtype::Modify, ordertype::Limit, Side::Buy, 0, OrderId(1), Price(10), Qty(1) };
+    EXPECT_TRUE(m.validate(modify));
+    modify.price_ = Price(0);
+    EXPECT_FALSE(m.validate(modify));
+    modify.price_ = Price(-10);
+    EXPECT_FALSE(m.validate(modify));
+    // No price at all is a replace of a stop.
+    modify.price_ = Price::none();
+    EXPECT_TRUE(m.validate(modify));
+    EXPECT_FALSE(m.submit(neworder(1, Side::Buy, ordertype::Limit, Price(-5), 1)));
+}
+
+// With recovery enabled a command's events are held until its WAL record is
+// committed; one that sweeps the book emits more of them than the event ring
+// (16 here) holds.
+TEST(ManagerTest, RecoverySweepLargerThanEventRing) {
+    scratchdir dir;
+    OrderbookManager m(1, {}, 8);
+    m.addsymbol("S");
+    m.enablerecovery((dir.path_ / "book").string(), 0);
+    m.start();
+    for (uint64_t i = 1; i <= 20; ++i) {
+        ASSERT_TRUE(m.submit(neworder(i, Side::Sell, ordertype::Limit, Price(100 + i), 1)));
+        ASSERT_EQ(pollfor(m, 1).size(), 1u);
+    }
+    ASSERT_TRUE(m.submit(neworder(21, Side::Buy, ordertype::Market, Price::none(), 20)));
+    vector<execevent> events = pollfor(m, 41);
+    m.stop();
+    ASSERT_EQ(events.size(), 41u);
+    EXPECT_EQ(events[0].type_, eventtype::New);
+    Qty bought(0);
+    for (size_t i = 1; i < events.size(); ++i) {
+        EXPECT_EQ(events[i].type_, eventtype::Fill);
+        if (events[i].id_ == OrderId(21)) bought += events[i].quantity_;
+    }
+    EXPECT_EQ(bought, Qty(20));
+    EXPECT_EQ(m.getbook(0).size(), 0u);
+}
+
+} // namespace
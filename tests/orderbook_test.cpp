@@ -0,0 +1,203 @@
+// Orderbook: order storage layout, status codes, and map-backed against dense books.
+#include "commandflow.h"
+
+namespace {
+
+TEST(OrderbookTest, NodesAreCacheLines) {
+    EXPECT_EQ(alignof(ordernode), 64u);
+    EXPECT_EQ(offsetof(ordernode, prev_), sizeof(orderstate));
+    objectpool<ordernode> pool;
+    for (uint64_t i = 1; i <= 10000; ++i) {
+        ordernode* node = pool.acquire(orderstate(ordertype::Limit, OrderId(i), Side::Buy, Price(100), Qty(1)));
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(node) % 64, 0u);
+    }
+}
+
+// Stop price and display size live outside the node, only for the orders
+// that have them, and go with the order.
+TEST(OrderbookTest, ExtrasFollowTheirOrder) {
+    Orderbook ob(64);
+    Order iceberg(ordertype::Limit, OrderId(1), Side::Sell, Price(100), Qty(10));
+    iceberg.setdisplay(Qty(2));
+    Order stop(ordertype::StopLimit, OrderId(2), Side::Buy, Price(105), Qty(3));
+    stop.setstopprice(Price(104));
+    ASSERT_EQ(ob.addorder(iceberg, [](const auto&) {}), orderstatus::Accepted);
+    ASSERT_EQ(ob.addorder(stop, [](const auto&) {}), orderstatus::Accepted);
+    ASSERT_EQ(ob.addorder(Order(ordertype::Limit, OrderId(3), Side::Sell, Price(101), Qty(1)), [](const auto&) {}),
+        orderstatus::Accepted);
+
+    optional<Order> found = ob.findorder(OrderId(1));
+    ASSERT_TRUE(found);
+    EXPECT_TRUE(found->hasextra());
+    EXPECT_EQ(found->getdisplay(), Qty(2));
+    EXPECT_EQ(found->getshown(), Qty(2));
+    EXPECT_EQ(found->gethidden(), Qty(8));
+    found = ob.findorder(OrderId(2));
+    ASSERT_TRUE(found);
+    EXPECT_EQ(found->getstopprice(), Price(104));
+    EXPECT_EQ(found->getprice(), Price(105));
+    found = ob.findorder(OrderId(3));
+    ASSERT_TRUE(found);
+    EXPECT_FALSE(found->hasextra());
+    EXPECT_EQ(found->getstopprice(), Price::none());
+
+    // Once the iceberg is gone its ID carries nothing over to a new order.
+    ASSERT_EQ(ob.cancelorder(OrderId(1)), orderstatus::Accepted);
+    ASSERT_EQ(ob.addorder(Order(ordertype::Limit, OrderId(1), Side::Sell, Price(102), Qty(5)), [](const auto&) {}),
+        orderstatus::Accepted);
+    found = ob.findorder(OrderId(1));
+    ASSERT_TRUE(found);
+    EXPECT_FALSE(found->hasextra());
+    EXPECT_EQ(found->getdisplay(), Qty(0));
+    EXPECT_EQ(found->getshown(), Qty(5));
+}
+
+// A trade names the bid and the ask whichever side was the aggressor.
+TEST(OrderbookTest, TradeRecords) {
+    Orderbook ob(64);
+    ob.addorder(Order(ordertype::Limit, OrderId(1), Side::Sell, Price(100), Qty(5)));
+    trades result = ob.addorder(Order(ordertype::Limit, OrderId(2), Side::Buy, Price(101), Qty(3)));
+    ASSERT_EQ(result.size(), 1u);
+    EXPECT_EQ(result[0].bid_, OrderId(2));
+    EXPECT_EQ(result[0].ask_, OrderId(1));
+    EXPECT_EQ(result[0].price_, Price(100));
+    EXPECT_EQ(result[0].quantity_, Qty(3));
+
+    ob.addorder(Order(ordertype::Limit, OrderId(3), Side::Buy, Price(99), Qty(4)));
+    ob.addorder(Order(ordertype::Limit, OrderId(4), Side::Buy, Price(98), Qty(5)));
+    result = ob.addorder(Order(OrderId(5), Side::Sell, Qty(6)));
+    ASSERT_EQ(result.size(), 2u);
+    EXPECT_EQ(result[0].bid_, OrderId(3));
+    EXPECT_EQ(result[0].ask_, OrderId(5));
+    EXPECT_EQ(result[0].price_, Price(99));
+    EXPECT_EQ(result[0].quantity_, Qty(4));
+    EXPECT_EQ(result[1].bid_, OrderId(4));
+    EXPECT_EQ(result[1].ask_, OrderId(5));
+    EXPECT_EQ(result[1].price_, Price(98));
+    EXPECT_EQ(result[1].quantity_, Qty(2));
+}
+
+// Every sink event an operation reports, as text.
+struct eventlog {
+    void operator()(const trade& t) { out_ << "trade " << t.bid_ << '/' << t.ask_ << ' '; }
+    void operator()(const orderaccepted& a) { out_ << "accepted " << a.id_ << ' '; }
+    void operator()(const selftrade& s) { out_ << "selftrade " << s.id_ << ' '; }
+    void operator()(const stoptrigger& s) { out_ << "trigger " << s.id_ << ' '; }
+    void operator()(const stopexpiry& s) { out_ << "expiry " << s.id_ << ' '; }
+    ostringstream& out_;
+};
+
+// op must return want, report nothing and leave ob as it was.
+template <class Op>
+void expectrefused(Orderbook& ob, orderstatus want, Op op) {
+    string depth = depthof(ob);
+    size_t size = ob.size();
+    Price last = ob.lastprice();
+    ostringstream events;
+    EXPECT_EQ(op(eventlog{ events }), want);
+    EXPECT_EQ(events.str(), "");
+    EXPECT_EQ(depthof(ob), depth);
+    EXPECT_EQ(ob.size(), size);
+    EXPECT_EQ(ob.lastprice(), last);
+}
+
+TEST(OrderbookTest, StatusCodes) {
+    Orderbook ob(ladderconfig{ Price(90), Price(1), 20 }, 64);
+    auto ignore = [](const auto&) {};
+    OrderId id(1);
+    Price price(100);
+    Qty qty(1);
+    static_assert(noexcept(ob.addorder(declval<const Order&>(), ignore)), "addorder is noexcept");
+    static_assert(noexcept(ob.cancelorder(id)), "cancelorder is noexcept");
+    static_assert(noexcept(ob.Matchorder(declval<const ordermodify&>(), ignore)), "Matchorder is noexcept");
+    static_assert(noexcept(ob.replaceorder(id, price, qty, ignore)), "replaceorder is noexcept");
+
+    ostringstream events;
+    ASSERT_EQ(ob.addorder(Order(ordertype::Limit, OrderId(1), Side::Sell, Price(100), Qty(5)), eventlog{ events }),
+        orderstatus::Accepted);
+    Order stop(ordertype::Stop, OrderId(2), Side::Buy, Price::none(), Qty(1));
+    stop.setstopprice(Price(105));
+    ASSERT_EQ(ob.addorder(stop, eventlog{ events }), orderstatus::Accepted);
+    ASSERT_EQ(ob.addorder(Order(ordertype::Limit, OrderId(3), Side::Buy, Price(99), Qty(2)), eventlog{ events }),
+        orderstatus::Accepted);
+    EXPECT_EQ(events.str(), "accepted 1 accepted 2 accepted 3 ");
+
+    // IDs already live, resting or dormant, whatever the new order's type.
+    for (uint64_t id : { 1, 2 }) {
+        for (ordertype type : { ordertype::Limit, ordertype::Market, ordertype::fillandkill, ordertype::StopLimit }) {
+            SCOPED_TRACE("id " + to_string(id) + " type " + to_string((int)type));
+            Order order(type, OrderId(id), Side::Buy, type == ordertype::Market ? Price::none() : Price(100), Qty(1));
+            if (type == ordertype::StopLimit) order.setstopprice(Price(101));
+            expectrefused(ob, orderstatus::Duplicate, [&](auto sink) { return ob.addorder(order, sink); });
+        }
+    }
+
+    // Orders the book cannot hold: off the ladder, or a stop with no stop price.
+    expectrefused(ob, orderstatus::Rejected, [&](auto sink) {
+        return ob.addorder(Order(ordertype::Limit, OrderId(10), Side::Buy, Price(200), Qty(1)), sink);
+    });
+    expectrefused(ob, orderstatus::Rejected, [&](auto sink) {
+        return ob.addorder(Order(ordertype::Stop, OrderId(10), Side::Buy, Price::none(), Qty(1)), sink);
+    });
+    Order offladder(ordertype::StopLimit, OrderId(10), Side::Buy, Price(50), Qty(1));
+    offladder.setstopprice(Price(101));
+    expectrefused(ob, orderstatus::Rejected, [&](auto sink) { return ob.addorder(offladder, sink); });
+
+    // Unknown IDs: never seen, or no longer live.
+    expectrefused(ob, orderstatus::UnknownId, [&](auto) { return ob.cancelorder(OrderId(10)); });
+    expectrefused(ob, orderstatus::UnknownId, [&](auto sink) {
+        return ob.Matchorder(ordermodify(OrderId(10), Side::Buy, Price(100), Qty(1)), sink);
+    });
+    expectrefused(ob, orderstatus::UnknownId, [&](auto sink) { return ob.replaceorder(OrderId(10), Price(100), Qty(1), sink); });
+    ASSERT_EQ(ob.cancelorder(OrderId(3)), orderstatus::Accepted);
+    expectrefused(ob, orderstatus::UnknownId, [&](auto) { return ob.cancelorder(OrderId(3)); });
+
+    // Modifies to a price the book cannot hold, and a replace that leaves
+    // nothing open: order 1 has 2 of 5 filled.
+    expectrefused(ob, orderstatus::Rejected, [&](auto sink) {
+        return ob.Matchorder(ordermodify(OrderId(1), Side::Sell, Price(200), Qty(1)), sink);
+    });
+    expectrefused(ob, orderstatus::Rejected, [&](auto sink) {
+        return ob.Matchorder(ordermodify(OrderId(1), Side::Sell, Price::none(), Qty(1)), sink);
+    });
+    ob.addorder(Order(OrderId(11), Side::Buy, Qty(2)));
+    expectrefused(ob, orderstatus::Rejected, [&](auto sink) { return ob.replaceorder(OrderId(1), Price(100), Qty(2), sink); });
+    ostringstream replaced;
+    EXPECT_EQ(ob.replaceorder(OrderId(1), Price(100), Qty(3), eventlog{ replaced }), orderstatus::Accepted);
+    EXPECT_EQ(replaced.str(), "accepted 1 ");
+    EXPECT_EQ(ob.findorder(OrderId(1))->getrem(), Qty(1));
+}
+
+// A dense ladder wide enough for the flow must behave exactly like the map.
+TEST(OrderbookTest, DenseLadderMatchesMap) {
+    for (uint64_t seed = 1; seed <= 100; ++seed) {
+        SCOPED_TRACE("seed " + to_string(seed));
+        Orderbook map(64), dense(ladderconfig{ Price(900), Price(1), 200 }, 64);
+        map.setstpmode((stpmode)(seed % 5));
+        dense.setstpmode((stpmode)(seed % 5));
+        vector<ordercommand> cmds = randomcommands(seed, 2000, false);
+        for (size_t i = 0; i < cmds.size(); ++i) {
+            vector<execevent> expected, actual;
+            applycommand(map, cmds[i], [&](const execevent& ev) { expected.push_back(ev); });
+            applycommand(dense, cmds[i], [&](const execevent& ev) { actual.push_back(ev); });
+            ASSERT_EQ(actual, expected) << "command " << i;
+            if (i % 50 == 0) {
+                ASSERT_EQ(depthof(dense), depthof(map)) << "command " << i;
+            }
+        }
+        ASSERT_EQ(depthof(dense), depthof(map));
+        ASSERT_EQ(dense.size(), map.size());
+        EXPECT_EQ(dense.lastprice(), map.lastprice());
+        for (const ordercommand& cmd : cmds) {
+            optional<Order> a = map.findorder(cmd.id_), b = dense.findorder(cmd.id_);
+            ASSERT_EQ(a.has_value(), b.has_value());
+            if (!a) continue;
+            EXPECT_EQ(b->getprice(), a->getprice());
+            EXPECT_EQ(b->getrem(), a->getrem());
+            EXPECT_EQ(b->gethidden(), a->gethidden());
+            EXPECT_EQ(b->getstopprice(), a->getstopprice());
+        }
+    }
+}
+
+} // namespace
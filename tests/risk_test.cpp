@@ -0,0 +1,177 @@
+// Pre-trade risk checks, one limit at a time. Prices are in price units, so
+// notional is price.value() * quantity.
+#include <gtest/gtest.h>
+#include "risk.h"
+
+namespace {
+
+constexpr int book = 0;
+constexpr uint64_t second = 1000000000;
+
+riskresult buy(riskengine& risk, int acct, int64_t price, int64_t qty, uint64_t now = 0) {
+    return risk.checknew(acct, book, Side::Buy, Price(price), Qty(qty), now);
+}
+
+TEST(RiskTest, DefaultLimitsAllowEverything) {
+    riskengine risk(1);
+    int acct = risk.addaccount({});
+    for (int i = 0; i < 1000; ++i) ASSERT_EQ(buy(risk, acct, 1000000, 1000000), riskresult::Ok);
+    EXPECT_EQ(risk.checknew(acct, book, Side::Sell, Price::none(), Qty(1), 0), riskresult::NoReference);
+}
+
+TEST(RiskTest, OrderQuantityAndNotional) {
+    riskengine risk(1);
+    risklimits limits;
+    limits.maxorderqty = Qty(100);
+    limits.maxnotional = 5000;
+    int acct = risk.addaccount(limits);
+    EXPECT_EQ(buy(risk, acct, 50, 100), riskresult::Ok);
+    EXPECT_EQ(buy(risk, acct, 1, 101), riskresult::MaxOrderQty);
+    EXPECT_EQ(buy(risk, acct, 51, 100), riskresult::MaxNotional);
+    // Both fail; the first in riskresult order is reported.
+    EXPECT_EQ(buy(risk, acct, 51, 101), riskresult::MaxOrderQty);
+}
+
+TEST(RiskTest, PriceBandAroundReference) {
+    riskengine risk(1);
+    risklimits limits;
+    limits.pricebandbps = 500;
+    int acct = risk.addaccount(limits);
+    EXPECT_EQ(buy(risk, acct, 1, 1), riskresult::Ok);  // No reference yet.
+    risk.setreference(book, Price(1000));
+    EXPECT_EQ(buy(risk, acct, 1050, 1), riskresult::Ok);
+    EXPECT_EQ(buy(risk, acct, 950, 1), riskresult::Ok);
+    EXPECT_EQ(buy(risk, acct, 1051, 1), riskresult::PriceBand);
+    EXPECT_EQ(buy(risk, acct, 949, 1), riskresult::PriceBand);
+    risk.trade(book, Price(1100));
+    EXPECT_EQ(buy(risk, acct, 1150, 1), riskresult::Ok);
+}
+
+// 2^40 x 2^24 is 2^64, which wraps to 0 in int64.
+TEST(RiskTest, NotionalDoesNotWrap) {
+    riskengine risk(1);
+    risklimits limits;
+    limits.maxnotional = 5000;
+    limits.pricebandbps = 500;
+    int acct = risk.addaccount(limits);
+    int open = risk.addaccount({});
+    int64_t price = int64_t(1) << 40, qty = int64_t(1) << 24;
+    EXPECT_EQ(buy(risk, acct, price, qty), riskresult::MaxNotional);
+    EXPECT_EQ(buy(risk, open, price, qty), riskresult::MaxNotional);
+    EXPECT_EQ(risk.checkreplace(acct, book, Side::Buy, Price(10), Qty(1), Price(price), Qty(qty), 0), riskresult::MaxNotional);
+    risk.setreference(book, Price(1000));
+    EXPECT_EQ(buy(risk, acct, numeric_limits<int64_t>::max(), 1), riskresult::MaxNotional);
+    EXPECT_EQ(buy(risk, open, numeric_limits<int64_t>::max() - 1, 1), riskresult::MaxNotional);
+    EXPECT_EQ(buy(risk, acct, -numeric_limits<int64_t>::max(), 1), riskresult::PriceBand);
+}
+
+TEST(RiskTest, MarketOrdersValuedAtReference) {
+    riskengine risk(1);
+    risklimits limits;
+    limits.maxnotional = 1000;
+    int acct = risk.addaccount(limits);
+    EXPECT_EQ(risk.checknew(acct, book, Side::Buy, Price::none(), Qty(1), 0), riskresult::NoReference);
+    risk.setreference(book, Price(100));
+    EXPECT_EQ(risk.checknew(acct, book, Side::Buy, Price::none(), Qty(10), 0), riskresult::Ok);
+    EXPECT_EQ(risk.checknew(acct, book, Side::Buy, Price::none(), Qty(11), 0), riskresult::MaxNotional);
+}
+
+TEST(RiskTest, OpenOrders) {
+    riskengine risk(1);
+    risklimits limits;
+    limits.maxopenorders = 2;
+    int acct = risk.addaccount(limits);
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_EQ(buy(risk, acct, 10, 1), riskresult::Ok);
+        risk.opened(acct, book, Side::Buy, Price(10), Qty(1));
+    }
+    EXPECT_EQ(buy(risk, acct, 10, 1), riskresult::MaxOpenOrders);
+    risk.closed(acct);
+    EXPECT_EQ(risk.openordersof(acct), 1);
+    EXPECT_EQ(buy(risk, acct, 10, 1), riskresult::Ok);
+}
+
+// Position counts every open order on the side as if it filled.
+TEST(RiskTest, PositionIncludesOpenOrders) {
+    riskengine risk(1);
+    risklimits limits;
+    limits.maxposition = Qty(100);
+    int acct = risk.addaccount(limits);
+    risk.opened(acct, book, Side::Buy, Price(10), Qty(60));
+    EXPECT_EQ(buy(risk, acct, 10, 40), riskresult::Ok);
+    EXPECT_EQ(buy(risk, acct, 10, 41), riskresult::MaxPosition);
+
+    // 60 bought: long 60, nothing open. Selling down through flat to short
+    // 100 is 160.
+    risk.fill(acct, book, Side::Buy, Price(10), Qty(60), Price(10));
+    EXPECT_EQ(risk.positionof(acct, book), Qty(60));
+    EXPECT_EQ(buy(risk, acct, 10, 41), riskresult::MaxPosition);
+    EXPECT_EQ(risk.checknew(acct, book, Side::Sell, Price(10), Qty(160), 0), riskresult::Ok);
+    EXPECT_EQ(risk.checknew(acct, book, Side::Sell, Price(10), Qty(161), 0), riskresult::MaxPosition);
+    EXPECT_EQ(risk.reference(book), Price(10));
+}
+
+TEST(RiskTest, ExposureAcrossBooks) {
+    riskengine risk(2);
+    risklimits limits;
+    limits.maxexposure = 10000;
+    int acct = risk.addaccount(limits);
+    risk.opened(acct, 0, Side::Buy, Price(100), Qty(60));
+    EXPECT_EQ(risk.exposureof(acct), 6000);
+    EXPECT_EQ(risk.checknew(acct, 1, Side::Sell, Price(40), Qty(100), 0), riskresult::Ok);
+    EXPECT_EQ(risk.checknew(acct, 1, Side::Sell, Price(40), Qty(101), 0), riskresult::MaxExposure);
+    // A fill turns open notional into position.
+    risk.fill(acct, 0, Side::Buy, Price(100), Qty(60), Price(99));
+    EXPECT_EQ(risk.exposureof(acct), 0);
+}
+
+// Only growth counts against position and exposure; a replace that shrinks
+// always passes them.
+TEST(RiskTest, ReplaceChecksGrowth) {
+    riskengine risk(1);
+    risklimits limits;
+    limits.maxposition = Qty(100);
+    limits.maxexposure = 10000;
+    int acct = risk.addaccount(limits);
+    risk.opened(acct, book, Side::Buy, Price(100), Qty(90));
+    EXPECT_EQ(risk.checkreplace(acct, book, Side::Buy, Price(100), Qty(90), Price(100), Qty(100), 0), riskresult::Ok);
+    EXPECT_EQ(risk.checkreplace(acct, book, Side::Buy, Price(100), Qty(90), Price(100), Qty(101), 0), riskresult::MaxPosition);
+    EXPECT_EQ(risk.checkreplace(acct, book, Side::Buy, Price(100), Qty(90), Price(112), Qty(90), 0), riskresult::MaxExposure);
+    EXPECT_EQ(risk.checkreplace(acct, book, Side::Buy, Price(100), Qty(90), Price(50), Qty(10), 0), riskresult::Ok);
+}
+
+// 10 messages a second with a burst of 3: three back to back, then one
+// every 100ms.
+TEST(RiskTest, ThrottleBurstThenRate) {
+    riskengine risk(1);
+    risklimits limits;
+    limits.maxmessagespersecond = 10;
+    limits.burst = 3;
+    int acct = risk.addaccount(limits);
+    uint64_t now = 5 * second;
+    for (int i = 0; i < 3; ++i) EXPECT_EQ(buy(risk, acct, 10, 1, now), riskresult::Ok);
+    EXPECT_EQ(buy(risk, acct, 10, 1, now), riskresult::Throttled);
+    EXPECT_EQ(buy(risk, acct, 10, 1, now + second / 10 - 1), riskresult::Throttled);
+    EXPECT_EQ(buy(risk, acct, 10, 1, now + second / 10), riskresult::Ok);
+    EXPECT_EQ(buy(risk, acct, 10, 1, now + second / 10), riskresult::Throttled);
+    // Idle long enough and the whole burst is back.
+    now += 10 * second;
+    for (int i = 0; i < 3; ++i) EXPECT_EQ(buy(risk, acct, 10, 1, now), riskresult::Ok);
+    // Replaces count too; a throttled message reports nothing else.
+    EXPECT_EQ(risk.checkreplace(acct, book, Side::Buy, Price(10), Qty(1), Price(10), Qty(1), now), riskresult::Throttled);
+}
+
+TEST(RiskTest, AccountsAreIndependent) {
+    riskengine risk(1);
+    risklimits tight;
+    tight.maxopenorders = 0;
+    int a = risk.addaccount(tight);
+    int b = risk.addaccount({});
+    EXPECT_EQ(buy(risk, a, 10, 1), riskresult::MaxOpenOrders);
+    EXPECT_EQ(buy(risk, b, 10, 1), riskresult::Ok);
+    risk.fill(b, book, Side::Buy, Price(10), Qty(5), Price(10));
+    EXPECT_EQ(risk.positionof(a, book), Qty(0));
+    EXPECT_EQ(risk.positionof(b, book), Qty(5));
+}
+
+} // namespace
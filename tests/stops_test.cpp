@@ -0,0 +1,178 @@
+// Stop, stop-limit and iceberg orders on map and dense books.
+#include "commandflow.h"
+
+namespace {
+
+class StopsTest : public BookTest {
+protected:
+    vector<execevent> limit(uint64_t id, Side side, int64_t price, int64_t qty, int64_t display = 0) {
+        ordercommand cmd{ commandtype::New, ordertype::Limit, side, 0, OrderId(id), Price(price), Qty(qty) };
+        cmd.display_ = Qty(display);
+        return apply(cmd);
+    }
+    // A Stop when price is none, else a StopLimit.
+    vector<execevent> stop(uint64_t id, Side side, int64_t trigger, int64_t qty, Price price = Price::none()) {
+        ordercommand cmd{ commandtype::New, price == Price::none() ? ordertype::Stop : ordertype::StopLimit, side, 0,
+            OrderId(id), price, Qty(qty) };
+        cmd.stop_ = Price(trigger);
+        return apply(cmd);
+    }
+};
+
+// A buy stop fires on a trade at or above its stop price and then trades as
+// a market order, its fills following the trade that set it off.
+TEST_P(StopsTest, BuyStopFiresAtItsPrice) {
+    limit(1, Side::Sell, 100, 5);
+    limit(2, Side::Sell, 101, 10);
+    vector<execevent> expected{ event(eventtype::New, 10, Side::Buy, Price::none(), 3) };
+    EXPECT_EQ(stop(10, Side::Buy, 101, 3), expected);
+    EXPECT_EQ(book_->size(), 3u);
+    EXPECT_EQ(depthof(*book_), "| 100x5/1 101x10/1 | ");
+
+    expected = { event(eventtype::New, 11, Side::Buy, Price(100), 5) };
+    trade(expected, 11, 1, 100, 5);
+    EXPECT_EQ(limit(11, Side::Buy, 100, 5), expected);
+
+    expected = { event(eventtype::New, 12, Side::Buy, Price(101), 2) };
+    trade(expected, 12, 2, 101, 2);
+    expected.push_back(event(eventtype::Triggered, 10, Side::Buy, Price(101), 0));
+    trade(expected, 10, 2, 101, 3);
+    EXPECT_EQ(limit(12, Side::Buy, 101, 2), expected);
+    EXPECT_EQ(depthof(*book_), "| 101x5/1 | ");
+    EXPECT_EQ(remaining(10), Qty(0));
+}
+
+// What a triggered Stop cannot fill expires, before the command's own
+// Expired event.
+TEST_P(StopsTest, StopRemainderExpires) {
+    limit(1, Side::Buy, 100, 2);
+    limit(2, Side::Buy, 99, 1);
+    stop(10, Side::Sell, 100, 5);
+    vector<execevent> expected{ event(eventtype::New, 11, Side::Sell, Price::none(), 1) };
+    trade(expected, 1, 11, 100, 1);
+    expected.push_back(event(eventtype::Triggered, 10, Side::Sell, Price(100), 0));
+    trade(expected, 1, 10, 100, 1);
+    trade(expected, 2, 10, 99, 1);
+    expected.push_back(event(eventtype::Expired, 10, Side::Sell, Price(0), 3));
+    EXPECT_EQ(apply(ordercommand{ commandtype::New, ordertype::Market, Side::Sell, 0, OrderId(11), Price::none(), Qty(1) }),
+        expected);
+    EXPECT_EQ(book_->size(), 0u);
+}
+
+// A triggered StopLimit rests what it cannot fill at its limit.
+TEST_P(StopsTest, StopLimitRestsRemainder) {
+    limit(1, Side::Sell, 100, 2);
+    limit(2, Side::Sell, 103, 5);
+    stop(10, Side::Buy, 100, 6, Price(101));
+    vector<execevent> expected{ event(eventtype::New, 11, Side::Buy, Price(100), 1) };
+    trade(expected, 11, 1, 100, 1);
+    expected.push_back(event(eventtype::Triggered, 10, Side::Buy, Price(100), 0));
+    trade(expected, 10, 1, 100, 1);
+    EXPECT_EQ(limit(11, Side::Buy, 100, 1), expected);
+    EXPECT_EQ(depthof(*book_), "101x5/1 | 103x5/1 | ");
+    optional<Order> rested = book_->findorder(OrderId(10));
+    ASSERT_TRUE(rested);
+    EXPECT_FALSE(rested->isstop());
+    EXPECT_EQ(rested->getrem(), Qty(5));
+}
+
+// Stops fire best trigger first, in arrival order at one trigger price, and
+// a fired stop's trades can set off more.
+TEST_P(StopsTest, CascadeOrder) {
+    limit(1, Side::Sell, 100, 1);
+    limit(2, Side::Sell, 101, 2);
+    limit(3, Side::Sell, 102, 10);
+    stop(20, Side::Buy, 102, 1);
+    stop(21, Side::Buy, 101, 1);
+    stop(22, Side::Buy, 101, 1);
+    vector<execevent> expected{ event(eventtype::New, 11, Side::Buy, Price(101), 2) };
+    trade(expected, 11, 1, 100, 1);
+    trade(expected, 11, 2, 101, 1);
+    expected.push_back(event(eventtype::Triggered, 21, Side::Buy, Price(101), 0));
+    trade(expected, 21, 2, 101, 1);
+    expected.push_back(event(eventtype::Triggered, 22, Side::Buy, Price(101), 0));
+    trade(expected, 22, 3, 102, 1);
+    expected.push_back(event(eventtype::Triggered, 20, Side::Buy, Price(102), 0));
+    trade(expected, 20, 3, 102, 1);
+    EXPECT_EQ(limit(11, Side::Buy, 101, 2), expected);
+    EXPECT_EQ(depthof(*book_), "| 102x8/1 | ");
+}
+
+// A stop whose price the market has already reached fires on entry.
+TEST_P(StopsTest, StopAlreadyThroughFiresOnEntry) {
+    limit(1, Side::Sell, 100, 5);
+    limit(2, Side::Buy, 100, 1);
+    vector<execevent> expected{ event(eventtype::New, 10, Side::Buy, Price::none(), 2),
+        event(eventtype::Triggered, 10, Side::Buy, Price(99), 0) };
+    trade(expected, 10, 1, 100, 2);
+    EXPECT_EQ(stop(10, Side::Buy, 99, 2), expected);
+}
+
+// A dormant stop can be cancelled, or replaced to the back of its trigger
+// level, keeping its stop price.
+TEST_P(StopsTest, CancelAndReplaceDormantStop) {
+    limit(1, Side::Sell, 100, 1);
+    limit(2, Side::Sell, 101, 10);
+    stop(20, Side::Buy, 100, 1);
+    stop(21, Side::Buy, 100, 1);
+    stop(22, Side::Buy, 100, 1);
+    EXPECT_EQ(apply(ordercommand{ commandtype::Cancel, ordertype::Limit, Side::Buy, 0, OrderId(22), Price(0), Qty(0) }),
+        vector<execevent>{ event(eventtype::Cancelled, 22, Side::Buy, Price(0), 0) });
+    EXPECT_EQ(apply(ordercommand{ commandtype::Modify, ordertype::Limit, Side::Buy, 0, OrderId(20), Price::none(), Qty(2) }),
+        vector<execevent>{ event(eventtype::Replaced, 20, Side::Buy, Price::none(), 2) });
+    vector<execevent> expected{ event(eventtype::New, 11, Side::Buy, Price(100), 1) };
+    trade(expected, 11, 1, 100, 1);
+    expected.push_back(event(eventtype::Triggered, 21, Side::Buy, Price(100), 0));
+    trade(expected, 21, 2, 101, 1);
+    expected.push_back(event(eventtype::Triggered, 20, Side::Buy, Price(100), 0));
+    trade(expected, 20, 2, 101, 2);
+    EXPECT_EQ(limit(11, Side::Buy, 100, 1), expected);
+}
+
+// An iceberg shows one slice; when it is used up the next slice goes to the
+// back of the queue, behind orders that arrived after the iceberg.
+TEST_P(StopsTest, IcebergRefillsAtTheBack) {
+    limit(1, Side::Sell, 100, 10, 3);
+    limit(2, Side::Sell, 100, 2);
+    EXPECT_EQ(depthof(*book_), "| 100x5/2 | ");
+
+    vector<execevent> expected{ event(eventtype::New, 11, Side::Buy, Price(100), 4) };
+    trade(expected, 11, 1, 100, 3);
+    trade(expected, 11, 2, 100, 1);
+    EXPECT_EQ(limit(11, Side::Buy, 100, 4), expected);
+    EXPECT_EQ(depthof(*book_), "| 100x4/2 | ");
+
+    expected = { event(eventtype::New, 12, Side::Buy, Price(100), 5) };
+    trade(expected, 12, 2, 100, 1);
+    trade(expected, 12, 1, 100, 3);
+    trade(expected, 12, 1, 100, 1);
+    EXPECT_EQ(limit(12, Side::Buy, 100, 5), expected);
+    EXPECT_EQ(depthof(*book_), "| 100x2/1 | ");
+    EXPECT_EQ(remaining(1), Qty(3));
+}
+
+// An incoming iceberg trades its full size, then rests a slice of the rest.
+TEST_P(StopsTest, IcebergTakesFullSizeThenRestsSlice) {
+    limit(1, Side::Sell, 100, 4);
+    vector<execevent> expected{ event(eventtype::New, 10, Side::Buy, Price(100), 10) };
+    trade(expected, 10, 1, 100, 4);
+    EXPECT_EQ(limit(10, Side::Buy, 100, 10, 2), expected);
+    EXPECT_EQ(depthof(*book_), "100x2/1 | | ");
+    EXPECT_EQ(remaining(10), Qty(6));
+}
+
+// Fill-or-kill counts an iceberg's hidden quantity as available.
+TEST_P(StopsTest, FillOrKillCountsHiddenQuantity) {
+    limit(1, Side::Sell, 100, 10, 1);
+    vector<execevent> expected{ event(eventtype::New, 10, Side::Buy, Price(100), 3) };
+    trade(expected, 10, 1, 100, 1);
+    trade(expected, 10, 1, 100, 1);
+    trade(expected, 10, 1, 100, 1);
+    EXPECT_EQ(apply(ordercommand{ commandtype::New, ordertype::fillorkill, Side::Buy, 0, OrderId(10), Price(100), Qty(3) }),
+        expected);
+    EXPECT_EQ(depthof(*book_), "| 100x1/1 | ");
+}
+
+INSTANTIATE_BOOK_TEST_SUITE(StopsTest);
+
+} // namespace
@@ -0,0 +1,159 @@
+// Self-trade prevention, one mode at a time, on map and dense books.
+#include "commandflow.h"
+
+namespace {
+
+constexpr uint32_t us = 1, them = 2;
+
+class StpTest : public BookTest {
+protected:
+    void setmode(stpmode mode) {
+        book_ = newbook();
+        book_->setstpmode(mode);
+    }
+
+    vector<execevent> submit(uint64_t id, Side side, int64_t price, int64_t qty, uint32_t owner,
+        ordertype type = ordertype::Limit) {
+        return apply(ordercommand{ commandtype::New, type, side, 0, OrderId(id), Price(price), Qty(qty), owner });
+    }
+
+    // Asks, best first: 101: 1 (them, 5), 2 (us, 4); 102: 3 (them, 5); 103: 4 (us, 3), 5 (them, 10).
+    void restasks() {
+        submit(1, Side::Sell, 101, 5, them);
+        submit(2, Side::Sell, 101, 4, us);
+        submit(3, Side::Sell, 102, 5, them);
+        submit(4, Side::Sell, 103, 3, us);
+        submit(5, Side::Sell, 103, 10, them);
+    }
+
+    // A buy of ours for 20 up to 103, which reaches all three ask levels.
+    vector<execevent> sweepasks() { return submit(10, Side::Buy, 103, 20, us); }
+
+    static execevent accepted(uint64_t id, Side side, int64_t price, int64_t qty) {
+        return event(eventtype::New, id, side, Price(price), qty);
+    }
+    static execevent prevented(uint64_t id, Side side, int64_t qty) {
+        return event(eventtype::SelfTrade, id, side, Price(0), qty);
+    }
+};
+
+TEST_P(StpTest, NoneTradesWithItself) {
+    setmode(stpmode::None);
+    restasks();
+    vector<execevent> expected{ accepted(10, Side::Buy, 103, 20) };
+    trade(expected, 10, 1, 101, 5);
+    trade(expected, 10, 2, 101, 4);
+    trade(expected, 10, 3, 102, 5);
+    trade(expected, 10, 4, 103, 3);
+    trade(expected, 10, 5, 103, 3);
+    EXPECT_EQ(sweepasks(), expected);
+    EXPECT_EQ(remaining(5), Qty(7));
+}
+
+// The aggressor's whole remainder goes at the first order of its own; what
+// it traded before that stands.
+TEST_P(StpTest, CancelNewestStopsTheAggressor) {
+    setmode(stpmode::CancelNewest);
+    restasks();
+    vector<execevent> expected{ accepted(10, Side::Buy, 103, 20) };
+    trade(expected, 10, 1, 101, 5);
+    expected.push_back(prevented(10, Side::Buy, 15));
+    EXPECT_EQ(sweepasks(), expected);
+    EXPECT_EQ(remaining(10), Qty(0));
+    EXPECT_EQ(remaining(2), Qty(4));
+    EXPECT_EQ(book_->size(), 4u);
+}
+
+// Each resting order of ours is cancelled as the sweep reaches it, on every
+// level, and the aggressor trades on past it.
+TEST_P(StpTest, CancelOldestRemovesRestingOrders) {
+    setmode(stpmode::CancelOldest);
+    restasks();
+    vector<execevent> expected{ accepted(10, Side::Buy, 103, 20) };
+    trade(expected, 10, 1, 101, 5);
+    expected.push_back(prevented(2, Side::Sell, 4));
+    trade(expected, 10, 3, 102, 5);
+    expected.push_back(prevented(4, Side::Sell, 3));
+    trade(expected, 10, 5, 103, 10);
+    EXPECT_EQ(sweepasks(), expected);
+    EXPECT_EQ(book_->size(), 0u);
+    EXPECT_EQ(book_->lastprice(), Price(103));
+}
+
+TEST_P(StpTest, CancelBothRemovesBoth) {
+    setmode(stpmode::CancelBoth);
+    restasks();
+    vector<execevent> expected{ accepted(10, Side::Buy, 103, 20) };
+    trade(expected, 10, 1, 101, 5);
+    expected.push_back(prevented(2, Side::Sell, 4));
+    expected.push_back(prevented(10, Side::Buy, 15));
+    EXPECT_EQ(sweepasks(), expected);
+    EXPECT_EQ(remaining(2), Qty(0));
+    EXPECT_EQ(book_->size(), 3u);
+    EXPECT_EQ(depthof(*book_), "| 102x5/1 103x13/2 | ");
+}
+
+// The smaller side is used up: here each of our resting orders, taking as
+// much off the aggressor, which then trades what is left.
+TEST_P(StpTest, DecrementAcrossLevels) {
+    setmode(stpmode::Decrement);
+    restasks();
+    vector<execevent> expected{ accepted(10, Side::Buy, 103, 20) };
+    trade(expected, 10, 1, 101, 5);
+    expected.push_back(prevented(2, Side::Sell, 4));
+    expected.push_back(prevented(10, Side::Buy, 4));
+    trade(expected, 10, 3, 102, 5);
+    expected.push_back(prevented(4, Side::Sell, 3));
+    expected.push_back(prevented(10, Side::Buy, 3));
+    trade(expected, 10, 5, 103, 3);
+    EXPECT_EQ(sweepasks(), expected);
+    EXPECT_EQ(remaining(5), Qty(7));
+    EXPECT_EQ(depthof(*book_), "| 103x7/1 | ");
+}
+
+// Here the resting order is the larger: it keeps its place with the
+// difference, ahead of an order that arrived later.
+TEST_P(StpTest, DecrementPartOfRestingOrder) {
+    setmode(stpmode::Decrement);
+    submit(1, Side::Sell, 100, 10, us);
+    submit(2, Side::Sell, 100, 5, them);
+    vector<execevent> expected{ accepted(10, Side::Buy, 100, 4), prevented(1, Side::Sell, 4), prevented(10, Side::Buy, 4) };
+    EXPECT_EQ(submit(10, Side::Buy, 100, 4, us), expected);
+    EXPECT_EQ(remaining(1), Qty(6));
+    EXPECT_EQ(depthof(*book_), "| 100x11/2 | ");
+    expected = { accepted(11, Side::Buy, 100, 6) };
+    trade(expected, 11, 1, 100, 6);
+    EXPECT_EQ(submit(11, Side::Buy, 100, 6, them), expected);
+}
+
+// Fill-or-kill does not count our own orders as liquidity, unless they
+// would be cancelled out of the way.
+TEST_P(StpTest, FillOrKillIgnoresOwnOrders) {
+    setmode(stpmode::CancelNewest);
+    restasks();
+    vector<execevent> expected{ accepted(10, Side::Buy, 102, 10),
+        event(eventtype::Expired, 10, Side::Buy, Price(102), 10) };
+    EXPECT_EQ(submit(10, Side::Buy, 102, 10, us, ordertype::fillorkill), expected);
+    EXPECT_EQ(book_->size(), 5u);
+
+    setmode(stpmode::CancelOldest);
+    restasks();
+    expected = { accepted(10, Side::Buy, 102, 10) };
+    trade(expected, 10, 1, 101, 5);
+    expected.push_back(prevented(2, Side::Sell, 4));
+    trade(expected, 10, 3, 102, 5);
+    EXPECT_EQ(submit(10, Side::Buy, 102, 10, us, ordertype::fillorkill), expected);
+}
+
+// Orders without an owner are never stopped.
+TEST_P(StpTest, UnownedOrdersTrade) {
+    setmode(stpmode::CancelBoth);
+    submit(1, Side::Sell, 100, 5, 0);
+    vector<execevent> expected{ accepted(10, Side::Buy, 100, 5) };
+    trade(expected, 10, 1, 100, 5);
+    EXPECT_EQ(submit(10, Side::Buy, 100, 5, 0), expected);
+}
+
+INSTANTIATE_BOOK_TEST_SUITE(StpTest);
+
+} // namespace